@@ -0,0 +1,1071 @@
+#include "MemoryManager.h"
+#include "SlabAllocator.h"
+#include "GrowableMemoryManager.h"
+#include "ManagedMemoryResource.h"
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <map>
+#include <string>
+#include <cstring>
+#include <random>
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+
+//benchmarks for the memory manager. unlike CommandLineTest, this doesn't check correctness, it just times things
+//build with make benchmark, which turns on optimization
+
+typedef std::chrono::steady_clock benchClock;
+
+void benchmarkAllocatorInterfaces();
+void benchmarkFreeLookup();
+void benchmarkBitmap();
+void benchmarkFirstFit();
+void benchmarkBuddy();
+void benchmarkLatency();
+void benchmarkSlab();
+void benchmarkThreads();
+void benchmarkRemoteFrees();
+void benchmarkArenaBacking();
+void benchmarkPersistentHeap();
+void benchmarkGrowable();
+void benchmarkAlignment();
+void benchmarkReallocate();
+void benchmarkCompaction();
+void benchmarkTelemetry();
+void benchmarkContainers();
+
+//helpers
+void makeHoles(MemoryManager& memoryManager, int holeCount);
+double allocationsPerSecond(MemoryManager& memoryManager, int iterations);
+int linearBlockScan(std::map<uint16_t, uint16_t>& allocatedMemory, int addressWordOffset);
+uint8_t* stringBitmap(uint16_t* holeList, size_t memorySizeInWords);
+void printLatencies(const char* name, std::vector<double>& nanoseconds);
+double threadedOperationsPerSecond(MemoryManager& memoryManager, std::mutex* globalLock, int threadCount);
+double pipelineBlocksPerSecond(MemoryManager& memoryManager, std::mutex* globalLock, int consumerCount);
+size_t residentMegabytes();
+
+//single producer, single consumer ring for handing blocks between threads in the pipeline benchmark, so the handoff itself doesn't need a lock
+struct HandOffRing {
+	void* slots[1024];
+	std::atomic<size_t> head;	//next slot to write, only the producer changes it
+	std::atomic<size_t> tail;	//next slot to read, only the consumer changes it
+	HandOffRing() : head(0), tail(0) {}
+	bool push(void* block);
+	void* pop();
+};
+
+int main() {
+	benchmarkAllocatorInterfaces();
+	benchmarkFreeLookup();
+	benchmarkBitmap();
+	benchmarkFirstFit();
+	benchmarkBuddy();
+	benchmarkLatency();
+	benchmarkSlab();
+	benchmarkThreads();
+	benchmarkRemoteFrees();
+	benchmarkArenaBacking();
+	benchmarkPersistentHeap();
+	benchmarkGrowable();
+	benchmarkAlignment();
+	benchmarkReallocate();
+	benchmarkCompaction();
+	benchmarkTelemetry();
+	benchmarkContainers();
+	return 0;
+}
+
+//fills the front of the arena with 1 word blocks and frees every other one, leaving holeCount 1 word holes (plus whatever's left at the end)
+void makeHoles(MemoryManager& memoryManager, int holeCount) {
+	unsigned wordSize = memoryManager.getWordSize();
+	std::vector<void*> blocks;
+	for (int i = 0; i < holeCount * 2; i++) {
+		blocks.push_back(memoryManager.allocate(wordSize));
+	}
+	for (int i = 0; i < holeCount * 2; i += 2) {
+		memoryManager.free(blocks[i]);
+	}
+}
+
+//allocate one word and free it again, over and over. every allocation has to pick from the full set of holes
+double allocationsPerSecond(MemoryManager& memoryManager, int iterations) {
+	unsigned wordSize = memoryManager.getWordSize();
+	auto start = benchClock::now();
+	for (int i = 0; i < iterations; i++) {
+		void* block = memoryManager.allocate(wordSize);
+		memoryManager.free(block);
+	}
+	double seconds = std::chrono::duration<double>(benchClock::now() - start).count();
+	return iterations / seconds;
+}
+
+void benchmarkAllocatorInterfaces() {
+	std::cout << "Benchmark: allocator interfaces (best fit, 1 word allocate + free)" << std::endl;
+	std::cout << std::setw(8) << "holes" << std::setw(16) << "list callback" << std::setw(16) << "view callback" << std::setw(16) << "built in" << std::endl;
+
+	int holeCounts[] = {10, 1000, 30000};
+	for (int holeCount : holeCounts) {
+		int iterations = holeCount >= 30000 ? 2000 : 200000 / (holeCount / 10 + 1) + 1000;
+		//the scanning interfaces are linear in holes, so scale the work down to keep the run short
+
+		MemoryManager listManager(8, [](int sizeInWords, void* list) { return bestFit(sizeInWords, list); });
+		//wrapped in a lambda so the manager can't recognize bestFit and switch to the built in version
+		//the arena is one word under the limit since bestFit can never pick a hole of exactly SIZE_LIMIT words
+		listManager.initialize(SIZE_LIMIT - 1);
+		makeHoles(listManager, holeCount);
+
+		MemoryManager viewManager(8, BEST_FIT);
+		viewManager.setViewAllocator(bestFitView);
+		viewManager.initialize(SIZE_LIMIT - 1);
+		makeHoles(viewManager, holeCount);
+
+		MemoryManager builtInManager(8, BEST_FIT);
+		builtInManager.initialize(SIZE_LIMIT - 1);
+		makeHoles(builtInManager, holeCount);
+
+		std::cout << std::setw(8) << holeCount << std::fixed << std::setprecision(0)
+			<< std::setw(16) << allocationsPerSecond(listManager, iterations)
+			<< std::setw(16) << allocationsPerSecond(viewManager, iterations)
+			<< std::setw(16) << allocationsPerSecond(builtInManager, iterations * 10) << std::endl;
+	}
+	std::cout << "(allocations per second)\n" << std::endl;
+}
+
+//the lookup free() used to do: walk every block from the start until one contains the address
+int linearBlockScan(std::map<uint16_t, uint16_t>& allocatedMemory, int addressWordOffset) {
+	for (auto iter = allocatedMemory.begin(); iter != allocatedMemory.end(); iter++) {
+		if (addressWordOffset >= iter->first && addressWordOffset < iter->first + iter->second) return iter->first;
+	}
+	return -1;
+}
+
+void benchmarkFreeLookup() {
+	std::cout << "Benchmark: free() block lookup (1 word blocks, freeing from the back half)" << std::endl;
+	std::cout << std::setw(8) << "blocks" << std::setw(18) << "old scan (ns)" << std::setw(18) << "free+alloc (ns)" << std::endl;
+
+	int blockCounts[] = {1000, 10000, 60000};
+	for (int blockCount : blockCounts) {
+		MemoryManager memoryManager(8, BEST_FIT);
+		memoryManager.initialize(blockCount);
+		std::vector<void*> blocks;
+		std::map<uint16_t, uint16_t> scanCopy;
+		for (int i = 0; i < blockCount; i++) {
+			blocks.push_back(memoryManager.allocate(8));
+			scanCopy[i] = 1;
+		}
+		//arena is exactly full, so every freed block is the only hole and gets handed right back
+
+		int iterations = 20000;
+		auto start = benchClock::now();
+		for (int i = 0; i < iterations; i++) {
+			int index = blockCount - 1 - (i % (blockCount / 2));
+			memoryManager.free(blocks[index]);
+			blocks[index] = memoryManager.allocate(8);
+		}
+		double newNanoseconds = std::chrono::duration<double, std::nano>(benchClock::now() - start).count() / iterations;
+
+		int scanIterations = 2000;
+		long checksum = 0;
+		start = benchClock::now();
+		for (int i = 0; i < scanIterations; i++) {
+			checksum += linearBlockScan(scanCopy, blockCount - 1 - (i % (blockCount / 2)));
+		}
+		double scanNanoseconds = std::chrono::duration<double, std::nano>(benchClock::now() - start).count() / scanIterations;
+		//checksum just keeps the compiler from throwing the scan away
+
+		std::cout << std::setw(8) << blockCount << std::fixed << std::setprecision(1)
+			<< std::setw(18) << scanNanoseconds << std::setw(18) << newNanoseconds
+			<< (checksum == 0 ? "?" : "") << std::endl;
+	}
+	std::cout << "(the old scan column is just the lookup, the new column is a whole free and allocate)\n" << std::endl;
+}
+
+//the string based getBitmap from before, working off a getList hole list so we can compare against it
+uint8_t* stringBitmap(uint16_t* holeList, size_t memorySizeInWords) {
+	size_t bitmapSizeWords = memorySizeInWords;
+	if (bitmapSizeWords % 8 != 0) bitmapSizeWords += (8 - bitmapSizeWords % 8);
+	size_t bitmapSize = bitmapSizeWords / 8;
+	uint8_t* bitmap = (uint8_t*) malloc(bitmapSize + 2);
+	bitmap[0] = static_cast<uint8_t>(bitmapSize % 256);
+	bitmap[1] = static_cast<uint8_t>(bitmapSize / 256);
+
+	size_t lastHoleEndpoint = 0;
+	size_t index = 2;
+	std::string bitstream = "";
+	for (uint16_t i = 0; i < holeList[0]; i++) {
+		size_t currentHoleBegin = holeList[1 + 2 * i];
+		size_t currentHoleLength = holeList[2 + 2 * i];
+		if (currentHoleBegin != lastHoleEndpoint) {
+			bitstream = std::string(currentHoleBegin - lastHoleEndpoint, '1') + bitstream;
+		}
+		bitstream = std::string(currentHoleLength, '0') + bitstream;
+		while (bitstream.length() >= 8) {
+			bitmap[index++] = std::stoi(bitstream.substr(bitstream.length() - 8, 8), nullptr, 2);
+			bitstream = bitstream.substr(0, bitstream.length() - 8);
+		}
+		lastHoleEndpoint = currentHoleBegin + currentHoleLength;
+	}
+	if (lastHoleEndpoint != memorySizeInWords) {
+		bitstream = std::string(memorySizeInWords - lastHoleEndpoint, '1') + bitstream;
+	}
+	if (memorySizeInWords != bitmapSizeWords) {
+		bitstream = std::string(bitmapSizeWords - memorySizeInWords, '0') + bitstream;
+	}
+	while (bitstream.length() >= 8) {
+		bitmap[index++] = std::stoi(bitstream.substr(bitstream.length() - 8, 8), nullptr, 2);
+		bitstream = bitstream.substr(0, bitstream.length() - 8);
+	}
+	return bitmap;
+}
+
+void benchmarkBitmap() {
+	std::cout << "Benchmark: getBitmap on a fully fragmented arena (every other word free)" << std::endl;
+	std::cout << std::setw(8) << "words" << std::setw(16) << "string (us)" << std::setw(16) << "runs (us)" << std::setw(10) << "speedup" << std::setw(12) << "identical" << std::endl;
+
+	size_t wordCounts[] = {1003, 16384, SIZE_LIMIT};
+	for (size_t wordCount : wordCounts) {
+		MemoryManager memoryManager(8, BEST_FIT);
+		memoryManager.initialize(wordCount);
+		makeHoles(memoryManager, wordCount / 2);
+		uint16_t* holeList = static_cast<uint16_t*>(memoryManager.getList());
+		size_t bitmapBytes = (wordCount + 7) / 8 + 2;
+
+		int iterations = wordCount > 20000 ? 20 : 200;
+		uint8_t* oldBitmap = nullptr;
+		auto start = benchClock::now();
+		for (int i = 0; i < iterations; i++) {
+			std::free(oldBitmap);
+			oldBitmap = stringBitmap(holeList, wordCount);
+		}
+		double oldMicroseconds = std::chrono::duration<double, std::micro>(benchClock::now() - start).count() / iterations;
+
+		uint8_t* newBitmap = nullptr;
+		start = benchClock::now();
+		for (int i = 0; i < iterations * 50; i++) {
+			std::free(newBitmap);
+			newBitmap = static_cast<uint8_t*>(memoryManager.getBitmap());
+		}
+		double newMicroseconds = std::chrono::duration<double, std::micro>(benchClock::now() - start).count() / (iterations * 50);
+
+		bool identical = memcmp(oldBitmap, newBitmap, bitmapBytes) == 0;
+		std::cout << std::setw(8) << wordCount << std::fixed << std::setprecision(2)
+			<< std::setw(16) << oldMicroseconds << std::setw(16) << newMicroseconds
+			<< std::setw(9) << std::setprecision(0) << oldMicroseconds / newMicroseconds << "x"
+			<< std::setw(12) << (identical ? "yes" : "NO") << std::endl;
+
+		std::free(oldBitmap);
+		std::free(newBitmap);
+		std::free(holeList);
+	}
+	std::cout << std::endl;
+}
+
+void benchmarkFirstFit() {
+	std::cout << "Benchmark: first fit past N 1 word holes (2 word allocate + free)" << std::endl;
+	std::cout << std::setw(8) << "holes" << std::setw(16) << "hole map" << std::setw(16) << "live bitmap" << std::endl;
+
+	int holeCounts[] = {10, 1000, 30000};
+	for (int holeCount : holeCounts) {
+		MemoryManager mapManager(8, FIRST_FIT);
+		mapManager.initialize(SIZE_LIMIT);
+		makeHoles(mapManager, holeCount);
+
+		MemoryManager bitmapManager(8, BITMAP_FIRST_FIT);
+		bitmapManager.initialize(SIZE_LIMIT);
+		makeHoles(bitmapManager, holeCount);
+
+		int iterations = holeCount >= 30000 ? 5000 : 100000;
+		double rates[2];
+		MemoryManager* managers[] = {&mapManager, &bitmapManager};
+		for (int m = 0; m < 2; m++) {
+			auto start = benchClock::now();
+			for (int i = 0; i < iterations; i++) {
+				managers[m]->free(managers[m]->allocate(16));
+			}
+			rates[m] = iterations / std::chrono::duration<double>(benchClock::now() - start).count();
+		}
+		//every 1 word hole is too small, so the answer is the space at the end. the bitmap scans past all of them to get there,
+		//the hole map's first fit index skips straight over them
+
+		std::cout << std::setw(8) << holeCount << std::fixed << std::setprecision(0)
+			<< std::setw(16) << rates[0] << std::setw(16) << rates[1] << std::endl;
+	}
+	std::cout << "(allocations per second)\n" << std::endl;
+}
+
+void benchmarkBuddy() {
+	std::cout << "Benchmark: random power of two sizes (1 to 64 words), arena kept around 3/4 full" << std::endl;
+	std::cout << std::setw(12) << "engine" << std::setw(16) << "ops/second" << std::setw(12) << "failed" << std::setw(12) << "holes" << std::endl;
+
+	const char* names[] = {"best fit", "buddy"};
+	ArenaEngine engines[] = {HOLE_MAP_ENGINE, BUDDY_ENGINE};
+	for (int e = 0; e < 2; e++) {
+		MemoryManager memoryManager(8, BEST_FIT);
+		memoryManager.initialize(SIZE_LIMIT - 1, engines[e]);
+		std::mt19937 random(1234);
+		//same seed for both, so they see the exact same sequence of requests
+
+		std::vector<void*> blocks;
+		size_t liveWords = 0;
+		int failed = 0;
+		int operations = 1000000;
+		auto start = benchClock::now();
+		for (int i = 0; i < operations; i++) {
+			if (blocks.empty() || (liveWords < SIZE_LIMIT * 3 / 4 && random() % 2 == 0)) {
+				size_t words = static_cast<size_t>(1) << (random() % 7);
+				void* block = memoryManager.allocate(words * 8);
+				if (block == nullptr) failed++;
+				else {
+					blocks.push_back(block);
+					liveWords += words;
+				}
+			}
+			else {
+				size_t index = random() % blocks.size();
+				liveWords -= memoryManager.getAllocationSize(blocks[index]) / 8;
+				memoryManager.free(blocks[index]);
+				blocks[index] = blocks.back();
+				blocks.pop_back();
+			}
+		}
+		double seconds = std::chrono::duration<double>(benchClock::now() - start).count();
+
+		uint16_t* holeList = static_cast<uint16_t*>(memoryManager.getList());
+		std::cout << std::setw(12) << names[e] << std::fixed << std::setprecision(0)
+			<< std::setw(16) << operations / seconds << std::setw(12) << failed << std::setw(12) << holeList[0] << std::endl;
+		std::free(holeList);
+	}
+	std::cout << "(holes is how many separate holes were left at the end, lower is less fragmented)\n" << std::endl;
+}
+
+//one row of the latency table: how many calls landed in each bucket, then percentiles. sorts the samples in place
+void printLatencies(const char* name, std::vector<double>& nanoseconds) {
+	double bucketLimits[] = {100, 250, 500, 1000, 5000, 25000};
+	int bucketCounts[7] = {0};
+	for (double sample : nanoseconds) {
+		int bucket = 0;
+		while (bucket < 6 && sample >= bucketLimits[bucket]) bucket++;
+		bucketCounts[bucket]++;
+	}
+	std::sort(nanoseconds.begin(), nanoseconds.end());
+
+	std::cout << std::setw(24) << name;
+	for (int count : bucketCounts) std::cout << std::setw(9) << count;
+	std::cout << std::fixed << std::setprecision(0)
+		<< std::setw(9) << nanoseconds[nanoseconds.size() / 2]
+		<< std::setw(9) << nanoseconds[nanoseconds.size() * 99 / 100]
+		<< std::setw(10) << nanoseconds.back() << std::endl;
+}
+
+void benchmarkLatency() {
+	std::cout << "Benchmark: latency of each call, random 1 to 64 word blocks on a fragmented arena" << std::endl;
+	std::cout << std::setw(24) << "" << std::setw(9) << "<100ns" << std::setw(9) << "<250ns" << std::setw(9) << "<500ns" << std::setw(9) << "<1us"
+		<< std::setw(9) << "<5us" << std::setw(9) << "<25us" << std::setw(9) << "more" << std::setw(9) << "p50" << std::setw(9) << "p99" << std::setw(10) << "max" << std::endl;
+
+	const char* names[] = {"best fit (list)", "best fit (index)", "TLSF"};
+	for (int m = 0; m < 3; m++) {
+		MemoryManager memoryManager(8, BEST_FIT);
+		if (m == 0) memoryManager.setAllocator([](int sizeInWords, void* list) { return bestFit(sizeInWords, list); });
+		//the original design: the manager makes a hole list and bestFit scans all of it
+		memoryManager.initialize(SIZE_LIMIT - 1, m == 2 ? TLSF_ENGINE : HOLE_MAP_ENGINE);
+
+		std::mt19937 random(99);
+		std::vector<void*> blocks;
+		size_t liveWords = 0;
+		for (int i = 0; i < 200000; i++) {
+			if (blocks.empty() || (liveWords < SIZE_LIMIT * 3 / 4 && random() % 2 == 0)) {
+				size_t words = random() % 64 + 1;
+				void* block = memoryManager.allocate(words * 8);
+				if (block != nullptr) {
+					blocks.push_back(block);
+					liveWords += words;
+				}
+			}
+			else {
+				size_t index = random() % blocks.size();
+				liveWords -= memoryManager.getAllocationSize(blocks[index]) / 8;
+				memoryManager.free(blocks[index]);
+				blocks[index] = blocks.back();
+				blocks.pop_back();
+			}
+		}
+		//warm up into a steady state with a few thousand holes before timing anything
+
+		int samples = m == 0 ? 5000 : 100000;
+		std::vector<double> allocateTimes, freeTimes;
+		allocateTimes.reserve(samples);
+		freeTimes.reserve(samples);
+		for (int i = 0; i < samples; i++) {
+			size_t index = random() % blocks.size();
+			auto start = benchClock::now();
+			memoryManager.free(blocks[index]);
+			auto middle = benchClock::now();
+			void* block = memoryManager.allocate((random() % 64 + 1) * 8);
+			auto end = benchClock::now();
+			freeTimes.push_back(std::chrono::duration<double, std::nano>(middle - start).count());
+			allocateTimes.push_back(std::chrono::duration<double, std::nano>(end - middle).count());
+			if (block != nullptr) blocks[index] = block;
+			else {
+				blocks[index] = blocks.back();
+				blocks.pop_back();
+			}
+		}
+		//free one, allocate one, so the arena stays in the same shape the whole time
+
+		std::string allocateName = std::string(names[m]) + " alloc";
+		std::string freeName = std::string(names[m]) + " free";
+		printLatencies(allocateName.c_str(), allocateTimes);
+		printLatencies(freeName.c_str(), freeTimes);
+	}
+	std::cout << "(calls per bucket, then percentiles in ns. the clock itself costs a few dozen ns per sample)\n" << std::endl;
+}
+
+void benchmarkSlab() {
+	std::cout << "Benchmark: small fixed sizes (16, 32 and 64 bytes), up to 4000 live objects" << std::endl;
+	std::cout << std::setw(16) << "" << std::setw(16) << "ops/second" << std::endl;
+
+	int operations = 1000000;
+	size_t objectSizes[] = {16, 32, 64};
+	for (int useSlabs = 0; useSlabs < 2; useSlabs++) {
+		MemoryManager memoryManager(8, BEST_FIT);
+		memoryManager.initialize(SIZE_LIMIT - 1);
+		SlabAllocator slabAllocator(memoryManager);
+		for (size_t objectSize : objectSizes) slabAllocator.addSizeClass(objectSize);
+
+		std::mt19937 random(5);
+		std::vector<void*> objects;
+		auto start = benchClock::now();
+		for (int i = 0; i < operations; i++) {
+			if (objects.size() < 4000 && (objects.empty() || random() % 2 == 0)) {
+				size_t size = objectSizes[random() % 3];
+				void* object = useSlabs ? slabAllocator.allocate(size) : memoryManager.allocate(size);
+				if (object != nullptr) objects.push_back(object);
+			}
+			else {
+				size_t index = random() % objects.size();
+				if (useSlabs) slabAllocator.free(objects[index]);
+				else memoryManager.free(objects[index]);
+				objects[index] = objects.back();
+				objects.pop_back();
+			}
+		}
+		double seconds = std::chrono::duration<double>(benchClock::now() - start).count();
+		std::cout << std::setw(16) << (useSlabs ? "slabs" : "manager") << std::fixed << std::setprecision(0) << std::setw(16) << operations / seconds << std::endl;
+
+		if (useSlabs) {
+			SlabStats stats = slabAllocator.getStats();
+			std::cout << "  " << std::setw(14) << "object size" << std::setw(10) << "slabs" << std::setw(10) << "live" << std::setw(14) << "utilization" << std::endl;
+			for (SlabClassStats& classStats : stats.classes) {
+				std::cout << "  " << std::setw(14) << classStats.objectSize << std::setw(10) << classStats.slabs << std::setw(10) << classStats.liveObjects
+					<< std::setw(13) << std::setprecision(1) << classStats.utilization * 100 << "%" << std::endl;
+			}
+			std::cout << "  " << stats.slabsCreated << " slabs created, " << stats.slabsReleased << " released back to the manager" << std::endl;
+		}
+	}
+	std::cout << std::endl;
+}
+
+//every thread allocates and frees small random sized blocks, keeping up to 200 of its own alive
+//with globalLock, every call is wrapped in that one mutex, the way you'd have to use the manager without thread safe mode
+double threadedOperationsPerSecond(MemoryManager& memoryManager, std::mutex* globalLock, int threadCount) {
+	int operationsPerThread = 400000;
+	std::vector<std::thread> threads;
+	auto start = benchClock::now();
+	for (int t = 0; t < threadCount; t++) {
+		threads.emplace_back([&memoryManager, globalLock, operationsPerThread, t]() {
+			std::mt19937 random(t);
+			std::vector<void*> blocks;
+			for (int i = 0; i < operationsPerThread; i++) {
+				if (blocks.size() < 200 && (blocks.empty() || random() % 2 == 0)) {
+					size_t size = (random() % 8 + 1) * 8;
+					void* block;
+					if (globalLock != nullptr) {
+						std::lock_guard<std::mutex> lock(*globalLock);
+						block = memoryManager.allocate(size);
+					}
+					else block = memoryManager.allocate(size);
+					if (block != nullptr) blocks.push_back(block);
+				}
+				else {
+					size_t index = random() % blocks.size();
+					if (globalLock != nullptr) {
+						std::lock_guard<std::mutex> lock(*globalLock);
+						memoryManager.free(blocks[index]);
+					}
+					else memoryManager.free(blocks[index]);
+					blocks[index] = blocks.back();
+					blocks.pop_back();
+				}
+			}
+			for (void* block : blocks) {
+				if (globalLock != nullptr) {
+					std::lock_guard<std::mutex> lock(*globalLock);
+					memoryManager.free(block);
+				}
+				else memoryManager.free(block);
+			}
+		});
+	}
+	for (std::thread& thread : threads) thread.join();
+	double seconds = std::chrono::duration<double>(benchClock::now() - start).count();
+	return threadCount * operationsPerThread / seconds;
+}
+
+void benchmarkThreads() {
+	int maxThreads = std::max(4, static_cast<int>(std::thread::hardware_concurrency()));
+	std::cout << "Benchmark: threads allocating and freeing 1 to 8 word blocks (" << std::thread::hardware_concurrency() << " cores)" << std::endl;
+	std::cout << std::setw(8) << "threads" << std::setw(18) << "global mutex" << std::setw(18) << "thread safe" << std::endl;
+
+	for (int threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+		MemoryManager lockedManager(8, BEST_FIT);
+		lockedManager.initialize(SIZE_LIMIT - 1);
+		std::mutex globalLock;
+
+		MemoryManager threadSafeManager(8, BEST_FIT);
+		threadSafeManager.setThreadSafe(true);
+		threadSafeManager.initialize(SIZE_LIMIT - 1);
+
+		std::cout << std::setw(8) << threadCount << std::fixed << std::setprecision(0)
+			<< std::setw(18) << threadedOperationsPerSecond(lockedManager, &globalLock, threadCount)
+			<< std::setw(18) << threadedOperationsPerSecond(threadSafeManager, nullptr, threadCount) << std::endl;
+	}
+	std::cout << "(total operations per second across all threads)\n" << std::endl;
+}
+
+bool HandOffRing::push(void* block) {
+	size_t currentHead = head.load(std::memory_order_relaxed);
+	if (currentHead - tail.load(std::memory_order_acquire) == 1024) return false;	//full
+	slots[currentHead % 1024] = block;
+	head.store(currentHead + 1, std::memory_order_release);
+	return true;
+}
+
+void* HandOffRing::pop() {
+	size_t currentTail = tail.load(std::memory_order_relaxed);
+	if (currentTail == head.load(std::memory_order_acquire)) return nullptr;	//empty
+	void* block = slots[currentTail % 1024];
+	tail.store(currentTail + 1, std::memory_order_release);
+	return block;
+}
+
+//one thread allocates and hands blocks round robin to the consumers, which free them
+//with globalLock both sides go through that mutex, otherwise the producer owns the manager and the consumers use freeRemote
+double pipelineBlocksPerSecond(MemoryManager& memoryManager, std::mutex* globalLock, int consumerCount) {
+	int blockCount = 1000000;
+	std::vector<HandOffRing> rings(consumerCount);
+	std::atomic<bool> producerDone(false);
+
+	std::vector<std::thread> consumers;
+	for (int c = 0; c < consumerCount; c++) {
+		consumers.emplace_back([&memoryManager, globalLock, &rings, &producerDone, c]() {
+			while (true) {
+				void* block = rings[c].pop();
+				if (block == nullptr) {
+					if (producerDone.load()) {
+						block = rings[c].pop();
+						if (block == nullptr) return;
+					}
+					else {
+						std::this_thread::yield();
+						continue;
+					}
+				}
+				//only quit once the producer's done and there's definitely nothing left
+				if (globalLock != nullptr) {
+					std::lock_guard<std::mutex> lock(*globalLock);
+					memoryManager.free(block);
+				}
+				else memoryManager.freeRemote(block);
+			}
+		});
+	}
+
+	auto start = benchClock::now();
+	for (int i = 0; i < blockCount; i++) {
+		void* block = nullptr;
+		while (block == nullptr) {
+			if (globalLock != nullptr) {
+				std::lock_guard<std::mutex> lock(*globalLock);
+				block = memoryManager.allocate(64);
+			}
+			else block = memoryManager.allocate(64);
+			if (block == nullptr) std::this_thread::yield();	//consumers are behind and the arena's full
+		}
+		while (!rings[i % consumerCount].push(block)) std::this_thread::yield();
+	}
+	producerDone = true;
+	for (std::thread& consumer : consumers) consumer.join();
+	double seconds = std::chrono::duration<double>(benchClock::now() - start).count();
+	return blockCount / seconds;
+}
+
+void benchmarkRemoteFrees() {
+	std::cout << "Benchmark: one producer allocating 64 byte blocks, consumers on other threads freeing them" << std::endl;
+	std::cout << std::setw(10) << "consumers" << std::setw(18) << "global mutex" << std::setw(18) << "freeRemote" << std::endl;
+
+	for (int consumerCount = 1; consumerCount <= 3; consumerCount++) {
+		MemoryManager lockedManager(8, BEST_FIT);
+		lockedManager.initialize(SIZE_LIMIT - 1);
+		std::mutex globalLock;
+
+		MemoryManager ownedManager(8, BEST_FIT);
+		ownedManager.initialize(SIZE_LIMIT - 1);
+
+		std::cout << std::setw(10) << consumerCount << std::fixed << std::setprecision(0)
+			<< std::setw(18) << pipelineBlocksPerSecond(lockedManager, &globalLock, consumerCount)
+			<< std::setw(18) << pipelineBlocksPerSecond(ownedManager, nullptr, consumerCount) << std::endl;
+	}
+	std::cout << "(blocks per second through the pipeline)\n" << std::endl;
+}
+
+//resident set size of this process, from the second number in /proc/self/statm (in pages)
+size_t residentMegabytes() {
+	std::ifstream statm("/proc/self/statm");
+	size_t totalPages = 0;
+	size_t residentPages = 0;
+	statm >> totalPages >> residentPages;
+	return residentPages * sysconf(_SC_PAGESIZE) / (1024 * 1024);
+}
+
+void benchmarkArenaBacking() {
+	std::cout << "Benchmark: resident memory for a 512MB arena, touching 256MB of 1MB blocks then freeing them" << std::endl;
+	std::cout << std::setw(24) << "backing" << std::setw(10) << "start" << std::setw(12) << "initialize" << std::setw(10) << "touched"
+		<< std::setw(10) << "freed" << std::setw(12) << "released" << std::setw(14) << "time (ms)" << std::endl;
+
+	const char* names[] = {"malloc", "mmap", "mmap + huge pages", "mmap + release on free"};
+	for (int b = 0; b < 4; b++) {
+		size_t start = residentMegabytes();
+		auto startTime = benchClock::now();
+		{
+			MemoryManager memoryManager(8, FIRST_FIT);
+			memoryManager.setWideOffsets(true);
+			if (b > 0) memoryManager.setMmapBacking(true, b == 2);
+			if (b == 3) memoryManager.setPageRelease(64 * 1024);
+			memoryManager.initialize(64 * 1024 * 1024);
+			size_t initialized = residentMegabytes();
+
+			std::vector<void*> blocks;
+			for (int i = 0; i < 256; i++) {
+				void* block = memoryManager.allocate(1024 * 1024);
+				memset(block, 1, 1024 * 1024);
+				blocks.push_back(block);
+			}
+			size_t touched = residentMegabytes();
+
+			for (void* block : blocks) memoryManager.free(block);
+			size_t freed = residentMegabytes();
+			memoryManager.releaseFreePages();
+			size_t released = residentMegabytes();
+
+			std::cout << std::setw(24) << names[b] << std::setw(10) << start << std::setw(12) << initialized << std::setw(10) << touched
+				<< std::setw(10) << freed << std::setw(12) << released;
+		}
+		double milliseconds = std::chrono::duration<double, std::milli>(benchClock::now() - startTime).count();
+		std::cout << std::setw(14) << std::fixed << std::setprecision(1) << milliseconds << std::endl;
+	}
+	std::cout << "(resident MB after each step. released is after releaseFreePages, which does nothing for malloc)\n" << std::endl;
+}
+
+void benchmarkPersistentHeap() {
+	std::cout << "Benchmark: getting a heap with N live blocks back after a restart" << std::endl;
+	std::cout << std::setw(10) << "blocks" << std::setw(16) << "sync (ms)" << std::setw(16) << "reattach (ms)" << std::setw(16) << "replay (ms)" << std::endl;
+
+	char heapFileName[] = "benchmarkHeap.bin";
+	int blockCounts[] = {1000, 100000, 1000000};
+	for (int blockCount : blockCounts) {
+		unlink(heapFileName);
+		std::vector<size_t> sizes;
+		std::mt19937 random(8);
+		for (int i = 0; i < blockCount; i++) sizes.push_back((random() % 16 + 1) * 8);
+
+		double syncMilliseconds;
+		{
+			MemoryManager memoryManager(8, BEST_FIT);
+			memoryManager.setWideOffsets(true);
+			memoryManager.initializeFromFile(heapFileName, blockCount * 17);
+			std::vector<void*> blocks;
+			for (size_t size : sizes) blocks.push_back(memoryManager.allocate(size));
+			for (size_t i = 0; i < blocks.size(); i += 2) memoryManager.free(blocks[i]);
+			//free every other one, so there are as many holes as blocks to rebuild
+
+			auto start = benchClock::now();
+			memoryManager.shutdown();
+			syncMilliseconds = std::chrono::duration<double, std::milli>(benchClock::now() - start).count();
+		}
+
+		MemoryManager reattached(8, BEST_FIT);
+		reattached.setWideOffsets(true);
+		auto start = benchClock::now();
+		reattached.initializeFromFile(heapFileName, 0);
+		double reattachMilliseconds = std::chrono::duration<double, std::milli>(benchClock::now() - start).count();
+
+		MemoryManager replayed(8, BEST_FIT);
+		replayed.setWideOffsets(true);
+		start = benchClock::now();
+		replayed.initialize(blockCount * 17);
+		std::vector<void*> blocks;
+		for (size_t size : sizes) blocks.push_back(replayed.allocate(size));
+		for (size_t i = 0; i < blocks.size(); i += 2) replayed.free(blocks[i]);
+		double replayMilliseconds = std::chrono::duration<double, std::milli>(benchClock::now() - start).count();
+		//the alternative without a persistent heap: run the same allocations again to get back to the same state
+
+		std::cout << std::setw(10) << blockCount << std::fixed << std::setprecision(2) << std::setw(16) << syncMilliseconds
+			<< std::setw(16) << reattachMilliseconds << std::setw(16) << replayMilliseconds << std::endl;
+		reattached.shutdown();
+	}
+	unlink(heapFileName);
+	std::cout << "(sync is shutdown writing the block table and flushing the file)\n" << std::endl;
+}
+
+void benchmarkGrowable() {
+	std::cout << "Benchmark: bursty load, up to 128MB of 1 to 16KB blocks then freed newest first down to a tenth, 4 times" << std::endl;
+	std::cout << std::setw(26) << "" << std::setw(14) << "ops/second" << std::setw(14) << "peak (MB)" << std::setw(14) << "quiet (MB)" << std::setw(10) << "failed" << std::endl;
+
+	size_t fixedWords = 160 * 1024 * 1024 / 8;
+	MemoryManager fixedManager(8, BEST_FIT);
+	fixedManager.setWideOffsets(true);
+	fixedManager.initialize(fixedWords);
+	//the worst case reservation, a bit over the peak so fragmentation doesn't make it fail
+
+	GrowableMemoryManager growableManager(8, BEST_FIT, 4 * 1024 * 1024 / 8);
+
+	for (int m = 0; m < 2; m++) {
+		std::mt19937 random(6);
+		std::vector<std::pair<void*, size_t>> blocks;
+		size_t liveBytes = 0;
+		size_t operations = 0;
+		size_t failed = 0;
+		size_t peakCapacity = 0;
+		size_t quietCapacity = 0;
+		auto start = benchClock::now();
+		for (int burst = 0; burst < 4; burst++) {
+			while (liveBytes < 128 * 1024 * 1024) {
+				size_t size = (random() % 16 + 1) * 1024;
+				void* block = m == 0 ? fixedManager.allocate(size) : growableManager.allocate(size);
+				operations++;
+				if (block == nullptr) {
+					failed++;
+					break;
+				}
+				blocks.push_back(std::make_pair(block, size));
+				liveBytes += size;
+			}
+			if (m == 1) peakCapacity = std::max(peakCapacity, growableManager.getStats().capacityBytes);
+
+			while (liveBytes > 128 * 1024 * 1024 / 10) {
+				if (m == 0) fixedManager.free(blocks.back().first);
+				else growableManager.free(blocks.back().first);
+				operations++;
+				liveBytes -= blocks.back().second;
+				blocks.pop_back();
+			}
+			//the burst's blocks go away newest first, like data that only lived for one busy period
+			if (m == 1) quietCapacity = growableManager.getStats().capacityBytes;
+		}
+		double seconds = std::chrono::duration<double>(benchClock::now() - start).count();
+		if (m == 0) peakCapacity = quietCapacity = fixedManager.getMemoryLimit();
+
+		std::cout << std::setw(26) << (m == 0 ? "fixed 160MB arena" : "growable, 4MB arenas") << std::fixed << std::setprecision(0)
+			<< std::setw(14) << operations / seconds << std::setw(14) << peakCapacity / (1024 * 1024)
+			<< std::setw(14) << quietCapacity / (1024 * 1024) << std::setw(10) << failed << std::endl;
+	}
+	std::cout << "(quiet is the capacity held at the end of the last quiet period)\n" << std::endl;
+}
+
+void benchmarkAlignment() {
+	std::cout << "Benchmark: 64 byte aligned blocks of 8 to 256 bytes, filling a 512KB arena then churning 200000 times" << std::endl;
+	std::cout << std::setw(28) << "" << std::setw(14) << "ops/second" << std::setw(16) << "blocks at full" << std::setw(14) << "arena used" << std::endl;
+
+	for (int m = 0; m < 2; m++) {
+		MemoryManager memoryManager(8, BEST_FIT);
+		memoryManager.initialize(SIZE_LIMIT);
+		std::mt19937 random(7);
+		std::vector<void*> blocks;
+		size_t liveBytes = 0;
+		std::vector<size_t> sizes;
+
+		auto allocateAligned = [&](size_t size) -> void* {
+			if (m == 1) return memoryManager.allocate(size, 64);
+			char* block = static_cast<char*>(memoryManager.allocate(size + 63));
+			if (block == nullptr) return nullptr;
+			return block + (64 - reinterpret_cast<uintptr_t>(block) % 64) % 64;
+		};
+		//the usual workaround without an aligned allocate: ask for alignment - 1 bytes extra and round the pointer up
+
+		while (true) {
+			size_t size = random() % 249 + 8;
+			void* block = allocateAligned(size);
+			if (block == nullptr) break;
+			blocks.push_back(block);
+			sizes.push_back(size);
+			liveBytes += size;
+		}
+		size_t blocksAtFull = blocks.size();
+		double used = static_cast<double>(liveBytes) / memoryManager.getMemoryLimit();
+
+		size_t operations = 0;
+		auto start = benchClock::now();
+		for (int i = 0; i < 200000; i++) {
+			size_t index = random() % blocks.size();
+			memoryManager.free(blocks[index]);
+			void* block = allocateAligned(random() % 249 + 8);
+			operations += 2;
+			if (block == nullptr) {
+				blocks[index] = blocks.back();
+				blocks.pop_back();
+			}
+			else blocks[index] = block;
+		}
+		double seconds = std::chrono::duration<double>(benchClock::now() - start).count();
+
+		std::cout << std::setw(28) << (m == 0 ? "over-allocate and round up" : "allocate(size, alignment)") << std::fixed << std::setprecision(0)
+			<< std::setw(14) << operations / seconds << std::setw(16) << blocksAtFull << std::setw(13) << used * 100 << "%" << std::endl;
+	}
+	std::cout << "(arena used is live bytes over the arena's size when the first allocation failed)\n" << std::endl;
+}
+
+void benchmarkReallocate() {
+	std::cout << "Benchmark: 64 buffers growing by 16 to 128 bytes at a time in random order, 8MB arena, until full" << std::endl;
+	std::cout << std::setw(28) << "" << std::setw(14) << "grows/second" << std::setw(14) << "MB copied" << std::setw(14) << "MB at full" << std::setw(10) << "holes" << std::endl;
+
+	for (int m = 0; m < 2; m++) {
+		MemoryManager memoryManager(8, BEST_FIT);
+		memoryManager.setWideOffsets(true);
+		memoryManager.initialize(1024 * 1024);
+		std::mt19937 random(8);
+		std::vector<std::pair<void*, size_t>> buffers;
+		for (int i = 0; i < 64; i++) buffers.push_back(std::make_pair(memoryManager.allocate(64), static_cast<size_t>(64)));
+
+		size_t grows = 0;
+		size_t bytesCopied = 0;
+		auto start = benchClock::now();
+		while (true) {
+			std::pair<void*, size_t>& buffer = buffers[random() % buffers.size()];
+			size_t newSize = buffer.second + random() % 113 + 16;
+			void* grown;
+			if (m == 1) {
+				grown = memoryManager.reallocate(buffer.first, newSize);
+				if (grown != buffer.first) bytesCopied += buffer.second;
+			}
+			else {
+				grown = memoryManager.allocate(newSize);
+				if (grown != nullptr) {
+					memcpy(grown, buffer.first, buffer.second);
+					memoryManager.free(buffer.first);
+					bytesCopied += buffer.second;
+				}
+			}
+			//without reallocate, every grow is a new block, a copy and a free
+			if (grown == nullptr) break;
+			buffer = std::make_pair(grown, newSize);
+			grows++;
+		}
+		double seconds = std::chrono::duration<double>(benchClock::now() - start).count();
+
+		size_t liveBytes = 0;
+		for (auto& buffer : buffers) liveBytes += buffer.second;
+		uint64_t* holeList = static_cast<uint64_t*>(memoryManager.getWideList());
+		std::cout << std::setw(28) << (m == 0 ? "allocate, copy and free" : "reallocate") << std::fixed
+			<< std::setw(14) << std::setprecision(0) << grows / seconds << std::setw(14) << std::setprecision(1) << bytesCopied / (1024.0 * 1024)
+			<< std::setw(14) << liveBytes / (1024.0 * 1024) << std::setw(10) << holeList[0] << std::endl;
+		std::free(holeList);
+		if (m == 1) {
+			ReallocationStats stats = memoryManager.getReallocationStats();
+			std::cout << "(reallocate grew " << stats.inPlace << " buffers in place and moved " << stats.moved << ". MB at full is the live buffers when a grow first failed)\n" << std::endl;
+		}
+	}
+}
+
+void benchmarkCompaction() {
+	std::cout << "Benchmark: 32MB arena of 1 to 64 word handle blocks (1 in 2000 pinned), half freed at random, compacted in 1ms slices" << std::endl;
+	std::cout << std::setw(10) << "slice" << std::setw(14) << "blocks moved" << std::setw(14) << "MB moved" << std::setw(12) << "holes" << std::setw(16) << "largest (KB)" << std::setw(16) << "fragmentation" << std::endl;
+
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.setWideOffsets(true);
+	memoryManager.initialize(4 * 1024 * 1024);
+	std::mt19937 random(9);
+	std::vector<uint64_t> handles;
+	std::vector<void*> pinned;
+	while (true) {
+		size_t size = (random() % 64 + 1) * 8;
+		if (random() % 2000 == 0) {
+			void* block = memoryManager.allocate(size);
+			if (block == nullptr) break;
+			pinned.push_back(block);
+		}
+		else {
+			uint64_t handle = memoryManager.allocateHandle(size);
+			if (handle == 0) break;
+			handles.push_back(handle);
+		}
+	}
+	for (size_t i = 0; i < handles.size(); i++) {
+		if (random() % 2 == 0) continue;
+		memoryManager.freeHandle(handles[i]);
+		handles[i] = handles.back();
+		handles.pop_back();
+		i--;
+	}
+	//just handles get freed, so the holes are all small and nothing big fits anywhere
+
+	bool bigFitsBefore = memoryManager.allocate(1024 * 1024) != nullptr;
+	CompactionReport report;
+	int slice = 0;
+	size_t totalMoved = 0;
+	double longestSlice = 0;
+	do {
+		auto start = benchClock::now();
+		report = memoryManager.compact(1000);
+		longestSlice = std::max(longestSlice, std::chrono::duration<double, std::milli>(benchClock::now() - start).count());
+		totalMoved += report.blocksMoved;
+		if (slice == 0) {
+			std::cout << std::setw(10) << "before" << std::setw(14) << "" << std::setw(14) << "" << std::setw(12) << report.holesBefore
+				<< std::setw(16) << report.largestHoleBefore * 8 / 1024 << std::setw(16) << std::setprecision(3) << report.fragmentationBefore << std::endl;
+		}
+		slice++;
+		if (slice <= 3 || report.finished) {
+			std::cout << std::setw(10) << slice << std::setw(14) << report.blocksMoved << std::setw(14) << std::setprecision(1) << report.wordsMoved * 8 / (1024.0 * 1024)
+				<< std::setw(12) << report.holesAfter << std::setw(16) << report.largestHoleAfter * 8 / 1024 << std::setw(16) << std::setprecision(3) << report.fragmentationAfter << std::endl;
+		}
+	} while (!report.finished);
+	bool bigFitsAfter = memoryManager.allocate(1024 * 1024) != nullptr;
+
+	std::cout << "(" << slice << " slices, " << totalMoved << " blocks moved, longest slice " << std::setprecision(2) << longestSlice << "ms. 1MB allocation "
+		<< (bigFitsBefore ? "fit" : "failed") << " before, " << (bigFitsAfter ? "fit" : "failed") << " after)\n" << std::endl;
+}
+
+void benchmarkTelemetry() {
+	std::cout << "Benchmark: reading free words, largest hole and hole count (best fit, 8 byte words)" << std::endl;
+	std::cout << std::setw(8) << "holes" << std::setw(18) << "getTelemetry (ns)" << std::setw(18) << "hole list (ns)" << std::endl;
+
+	int holeCounts[] = {10, 1000, 30000};
+	for (int holeCount : holeCounts) {
+		MemoryManager memoryManager(8, BEST_FIT);
+		memoryManager.initialize(SIZE_LIMIT);
+		makeHoles(memoryManager, holeCount);
+
+		int iterations = 20000;
+		size_t checksum = 0;
+		auto start = benchClock::now();
+		for (int i = 0; i < iterations; i++) {
+			MemoryTelemetry telemetry = memoryManager.getTelemetry();
+			checksum += telemetry.freeWords + telemetry.largestHole + telemetry.holeCount;
+		}
+		double telemetryNanoseconds = std::chrono::duration<double, std::nano>(benchClock::now() - start).count() / iterations;
+
+		int listIterations = holeCount >= 30000 ? 200 : 2000;
+		start = benchClock::now();
+		for (int i = 0; i < listIterations; i++) {
+			uint16_t* holeList = static_cast<uint16_t*>(memoryManager.getList());
+			size_t freeWords = 0;
+			size_t largestHole = 0;
+			for (int h = 0; h < holeList[0]; h++) {
+				freeWords += holeList[2 + h * 2];
+				largestHole = std::max(largestHole, static_cast<size_t>(holeList[2 + h * 2]));
+			}
+			checksum += freeWords + largestHole + holeList[0];
+			std::free(holeList);
+		}
+		double listNanoseconds = std::chrono::duration<double, std::nano>(benchClock::now() - start).count() / listIterations;
+		//the way to get these before telemetry: build the hole list and add it up
+
+		std::cout << std::setw(8) << holeCount << std::fixed << std::setprecision(0) << std::setw(18) << telemetryNanoseconds
+			<< std::setw(18) << listNanoseconds << (checksum == 0 ? "?" : "") << std::endl;
+		//checksum keeps the reads from being optimized out, like in benchmarkFreeLookup
+	}
+	std::cout << "(nanoseconds per read)\n" << std::endl;
+}
+
+//the same container workload on any resource, so the heap and the arenas run exactly the same code
+template <class MapAllocator>
+size_t runContainerWorkload(std::pmr::memory_resource* resource, const MapAllocator& mapAllocator, double* seconds) {
+	size_t checksum = 0;
+	std::mt19937 random(11);
+
+	auto start = benchClock::now();
+	for (int i = 0; i < 200; i++) {
+		std::pmr::vector<int> values(resource);
+		for (int v = 0; v < 10000; v++) values.push_back(v);
+		checksum += values.size();
+	}
+	seconds[0] = std::chrono::duration<double>(benchClock::now() - start).count();
+	//grown from empty each time, so every doubling is an allocate, a copy and a free
+
+	start = benchClock::now();
+	{
+		std::pmr::map<int, int> table(resource);
+		for (int i = 0; i < 200000; i++) {
+			int key = random() % 50000;
+			if (i % 3 == 2) table.erase(key);
+			else table[key] = i;
+		}
+		checksum += table.size();
+	}
+	seconds[1] = std::chrono::duration<double>(benchClock::now() - start).count();
+
+	start = benchClock::now();
+	{
+		std::pmr::vector<std::pmr::string> lines(resource);
+		for (int i = 0; i < 50000; i++) {
+			std::pmr::string line(resource);
+			int pieces = random() % 8 + 1;
+			for (int p = 0; p < pieces; p++) line += "a string piece ";
+			lines.push_back(std::move(line));
+		}
+		checksum += lines.size();
+	}
+	seconds[2] = std::chrono::duration<double>(benchClock::now() - start).count();
+	//past the small string buffer, so the strings themselves allocate and grow too
+
+	start = benchClock::now();
+	{
+		std::map<int, int, std::less<int>, MapAllocator> table(mapAllocator);
+		for (int i = 0; i < 200000; i++) {
+			int key = random() % 50000;
+			if (i % 3 == 2) table.erase(key);
+			else table[key] = i;
+		}
+		checksum += table.size();
+	}
+	seconds[3] = std::chrono::duration<double>(benchClock::now() - start).count();
+	//the classic allocator path, std::map with an allocator template argument instead of a pmr map
+
+	return checksum;
+}
+
+void benchmarkContainers() {
+	std::cout << "Benchmark: std containers on the default heap vs in a 64MB arena through ManagedMemoryResource and ManagedAllocator" << std::endl;
+	std::cout << std::setw(22) << "" << std::setw(14) << "vector grow" << std::setw(14) << "pmr map" << std::setw(14) << "pmr strings"
+		<< std::setw(14) << "std::map" << std::setw(10) << "spilled" << std::endl;
+
+	double operations[] = {200.0 * 10000, 200000, 50000, 200000};
+	for (int m = 0; m < 3; m++) {
+		double seconds[4];
+		size_t checksum;
+		size_t spilled = 0;
+		const char* name;
+		if (m == 0) {
+			name = "default heap";
+			checksum = runContainerWorkload(std::pmr::new_delete_resource(), std::allocator<std::pair<const int, int>>(), seconds);
+		}
+		else {
+			name = m == 1 ? "arena (best fit)" : "arena (tlsf)";
+			MemoryManager memoryManager(8, BEST_FIT);
+			memoryManager.setWideOffsets(true);
+			memoryManager.initialize(64 * 1024 * 1024 / 8, m == 1 ? HOLE_MAP_ENGINE : TLSF_ENGINE);
+			ManagedMemoryResource resource(memoryManager, std::pmr::new_delete_resource());
+			checksum = runContainerWorkload(&resource, ManagedAllocator<std::pair<const int, int>>(resource), seconds);
+			spilled = resource.getUpstreamAllocations();
+		}
+
+		std::cout << std::setw(22) << name << std::fixed << std::setprecision(0);
+		for (int w = 0; w < 4; w++) std::cout << std::setw(14) << operations[w] / seconds[w];
+		std::cout << std::setw(10) << spilled << (checksum == 0 ? "?" : "") << std::endl;
+	}
+	std::cout << "(operations per second. spilled is allocations that didn't fit in the arena and went to the heap instead)\n" << std::endl;
+}
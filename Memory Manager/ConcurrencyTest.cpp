@@ -0,0 +1,207 @@
+#include "MemoryManager.h"
+#include <thread>
+#include <mutex>
+#include <deque>
+#include <random>
+
+//checks the manager from several threads at once. built with ThreadSanitizer by make concurrencyTest,
+//so a data race fails the run even if every check below passes
+
+unsigned int testRemoteFrees(unsigned wordSize);
+unsigned int testThreadSafeMode(ArenaEngine engine);
+unsigned int testReinitializeWhileThreadsExit();
+
+//helpers
+bool arenaIsEmpty(MemoryManager& memoryManager, size_t sizeInWords);
+
+int main() {
+	unsigned int score = 0;
+	unsigned int total = 0;
+
+	score += testRemoteFrees(8);
+	total++;
+	score += testRemoteFrees(2);	//words too small to hold the link, so the remote frees go through heap nodes
+	total++;
+	score += testThreadSafeMode(HOLE_MAP_ENGINE);
+	total++;
+	score += testThreadSafeMode(TLSF_ENGINE);
+	total++;
+	score += testReinitializeWhileThreadsExit();
+	total++;
+
+	std::cout << "Score: " << score << " / " << total << std::endl;
+	return score == total ? 0 : 1;
+}
+
+//after everything is freed, the whole arena should be one hole again
+bool arenaIsEmpty(MemoryManager& memoryManager, size_t sizeInWords) {
+	uint64_t* holeList = static_cast<uint64_t*>(memoryManager.getWideList());
+	bool empty = holeList[0] == 1 && holeList[1] == 0 && holeList[2] == sizeInWords;
+	std::free(holeList);
+	return empty;
+}
+
+//one thread owns a normal (not thread safe) manager and allocates. three others check what's in each block and freeRemote it
+unsigned int testRemoteFrees(unsigned wordSize) {
+	std::cout << "Test: remote frees, word size " << wordSize << std::endl;
+	size_t arenaWords = 20000;
+	MemoryManager memoryManager(wordSize, BEST_FIT);
+	memoryManager.initialize(arenaWords);
+
+	std::mutex handOffLock;
+	std::deque<std::pair<uint8_t*, size_t>> handOff;
+	bool producerDone = false;
+	std::atomic<int> corruptBlocks(0);
+	std::atomic<int> freedBlocks(0);
+
+	std::vector<std::thread> consumers;
+	for (int c = 0; c < 3; c++) {
+		consumers.emplace_back([&]() {
+			while (true) {
+				std::pair<uint8_t*, size_t> block(nullptr, 0);
+				{
+					std::lock_guard<std::mutex> lock(handOffLock);
+					if (!handOff.empty()) {
+						block = handOff.front();
+						handOff.pop_front();
+					}
+					else if (producerDone) return;
+				}
+				if (block.first == nullptr) {
+					std::this_thread::yield();
+					continue;
+				}
+				for (size_t i = 0; i < block.second; i++) {
+					if (block.first[i] != static_cast<uint8_t>(block.second)) {
+						corruptBlocks++;
+						break;
+					}
+				}
+				memoryManager.freeRemote(block.first);
+				freedBlocks++;
+			}
+		});
+	}
+
+	std::mt19937 random(1);
+	int allocatedBlocks = 0;
+	for (int i = 0; i < 50000; i++) {
+		size_t size = random() % 64 + 1;
+		uint8_t* block = static_cast<uint8_t*>(memoryManager.allocate(size));
+		if (block == nullptr) {
+			std::this_thread::yield();	//arena's full, give the consumers a chance to catch up
+			continue;
+		}
+		memset(block, static_cast<uint8_t>(size), size);
+		allocatedBlocks++;
+		std::lock_guard<std::mutex> lock(handOffLock);
+		handOff.push_back(std::make_pair(block, size));
+	}
+	{
+		std::lock_guard<std::mutex> lock(handOffLock);
+		producerDone = true;
+	}
+	for (std::thread& consumer : consumers) consumer.join();
+
+	bool passed = corruptBlocks == 0 && freedBlocks == allocatedBlocks && arenaIsEmpty(memoryManager, arenaWords);
+	//getWideList catches up on the remote frees before it reads the holes
+	if (!passed) std::cout << "Failed: " << corruptBlocks << " corrupt blocks, " << freedBlocks << " of " << allocatedBlocks << " freed" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//four threads allocating, freeing their own blocks, and freeing each other's, all on one thread safe manager
+unsigned int testThreadSafeMode(ArenaEngine engine) {
+	std::cout << "Test: thread safe mode, " << (engine == TLSF_ENGINE ? "TLSF" : "hole map") << " engine" << std::endl;
+	size_t arenaWords = 60000;
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.setThreadSafe(true);
+	memoryManager.initialize(arenaWords, engine);
+
+	std::mutex exchangeLock;
+	std::vector<std::pair<uint64_t*, size_t>> exchange;
+	std::atomic<int> corruptBlocks(0);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&, t]() {
+			std::mt19937 random(t);
+			std::vector<std::pair<uint64_t*, size_t>> blocks;
+			for (int i = 0; i < 40000; i++) {
+				if (blocks.empty() || random() % 2 == 0) {
+					size_t words = random() % 4 == 0 ? random() % 40 + 1 : random() % THREAD_CACHE_MAX_WORDS + 1;
+					uint64_t* block = static_cast<uint64_t*>(memoryManager.allocate(words * 8));
+					if (block == nullptr) continue;
+					for (size_t w = 0; w < words; w++) block[w] = reinterpret_cast<uint64_t>(block) + w;
+					blocks.push_back(std::make_pair(block, words));
+				}
+				else {
+					size_t index = random() % blocks.size();
+					std::pair<uint64_t*, size_t> block = blocks[index];
+					blocks[index] = blocks.back();
+					blocks.pop_back();
+					for (size_t w = 0; w < block.second; w++) {
+						if (block.first[w] != reinterpret_cast<uint64_t>(block.first) + w) {
+							corruptBlocks++;
+							break;
+						}
+					}
+					if (random() % 3 == 0) {
+						std::lock_guard<std::mutex> lock(exchangeLock);
+						exchange.push_back(block);
+					}
+					else memoryManager.free(block.first);
+				}
+				//a third of the frees get left for some other thread to do
+
+				if (i % 100 == 0) {
+					std::lock_guard<std::mutex> lock(exchangeLock);
+					for (auto& block : exchange) memoryManager.free(block.first);
+					exchange.clear();
+				}
+			}
+			for (auto& block : blocks) memoryManager.free(block.first);
+		});
+	}
+	for (std::thread& thread : threads) thread.join();
+	for (auto& block : exchange) memoryManager.free(block.first);
+	memoryManager.flushThreadCache();
+	//the worker threads' caches were flushed when they exited, this is the main thread's
+
+	bool passed = corruptBlocks == 0 && arenaIsEmpty(memoryManager, arenaWords);
+	if (!passed) std::cout << "Failed: " << corruptBlocks << " corrupt blocks" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//threads with full caches exit while the owner reinitializes the arena over and over. each exiting thread has to hand its blocks
+//back to the arena they came from or drop them, never put them in a newer one
+unsigned int testReinitializeWhileThreadsExit() {
+	std::cout << "Test: reinitialize while threads exit" << std::endl;
+	size_t arenaWords = 20000;
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.setThreadSafe(true);
+	memoryManager.initialize(arenaWords);
+
+	std::atomic<int> readyThreads(0);
+	std::atomic<bool> exitNow(false);
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&]() {
+			std::vector<void*> blocks;
+			for (int i = 0; i < 400; i++) blocks.push_back(memoryManager.allocate((i % THREAD_CACHE_MAX_WORDS + 1) * 8));
+			for (void* block : blocks) memoryManager.free(block);
+			readyThreads++;
+			while (!exitNow) std::this_thread::yield();
+		});
+	}
+	//every thread is done allocating and freeing before anything is reinitialized, since doing both at once isn't allowed.
+	//what's left racing is the thread exits, which flush whatever the caches still hold
+
+	while (readyThreads < 4) std::this_thread::yield();
+	exitNow = true;
+	for (int i = 0; i < 50; i++) memoryManager.initialize(arenaWords);
+	for (std::thread& thread : threads) thread.join();
+
+	bool passed = arenaIsEmpty(memoryManager, arenaWords);
+	if (!passed) std::cout << "Failed: a thread's cached blocks ended up in the wrong arena" << std::endl;
+	return passed ? 1 : 0;
+}
@@ -0,0 +1,904 @@
+#include "MemoryManager.h"
+#include "SlabAllocator.h"
+#include "GrowableMemoryManager.h"
+#include "ManagedMemoryResource.h"
+#include <random>
+#include <thread>
+
+//checks that the features added on top of the original manager actually behave, one test per feature (and per engine where
+//the engines differ). built with AddressSanitizer and UBSan by make featureTest, so an overrun fails the run too
+
+unsigned int testWideOffsets();
+unsigned int testEngineChurn(ArenaEngine engine, unsigned wordSize);
+unsigned int testBuddyBlocks();
+unsigned int testFitStrategies();
+unsigned int testLiveBitmap();
+unsigned int testAlignedAllocate(ArenaEngine engine);
+unsigned int testReallocate(ArenaEngine engine);
+unsigned int testHandlesAndCompaction();
+unsigned int testTelemetry(ArenaEngine engine);
+unsigned int testTelemetryJson();
+unsigned int testTrace();
+unsigned int testThreadSafe();
+unsigned int testRemoteFree(unsigned wordSize);
+unsigned int testSlabAllocator();
+unsigned int testGrowable();
+unsigned int testPersistentHeap();
+unsigned int testManagedMemoryResource(ArenaEngine engine);
+
+//helpers
+const char* engineName(ArenaEngine engine);
+bool arenaIsEmpty(MemoryManager& memoryManager, size_t sizeInWords);
+void fillBlock(void* block, size_t sizeInBytes, uint8_t seed);
+bool checkBlock(void* block, size_t sizeInBytes, uint8_t seed);
+
+struct TestBlock {
+	void* address;
+	size_t sizeInBytes;
+	uint8_t seed;		//what fillBlock was given, so checkBlock can tell if anything changed
+};
+
+int main() {
+	unsigned int score = 0;
+	unsigned int total = 0;
+	ArenaEngine engines[] = {HOLE_MAP_ENGINE, BUDDY_ENGINE, TLSF_ENGINE};
+
+	score += testWideOffsets();
+	total++;
+	for (ArenaEngine engine : engines) {
+		score += testEngineChurn(engine, 8);
+		score += testEngineChurn(engine, 1);
+		total += 2;
+	}
+	score += testBuddyBlocks();
+	total++;
+	score += testFitStrategies();
+	total++;
+	score += testLiveBitmap();
+	total++;
+	for (ArenaEngine engine : engines) {
+		score += testAlignedAllocate(engine);
+		score += testReallocate(engine);
+		score += testTelemetry(engine);
+		score += testManagedMemoryResource(engine);
+		total += 4;
+	}
+	score += testHandlesAndCompaction();
+	total++;
+	score += testTelemetryJson();
+	total++;
+	score += testTrace();
+	total++;
+	score += testThreadSafe();
+	total++;
+	score += testRemoteFree(8);
+	score += testRemoteFree(4);
+	total += 2;
+	score += testSlabAllocator();
+	total++;
+	score += testGrowable();
+	total++;
+	score += testPersistentHeap();
+	total++;
+
+	std::cout << "Score: " << score << " / " << total << std::endl;
+	return score == total ? 0 : 1;
+}
+
+const char* engineName(ArenaEngine engine) {
+	if (engine == BUDDY_ENGINE) return "buddy";
+	if (engine == TLSF_ENGINE) return "TLSF";
+	return "hole map";
+}
+
+//after everything is freed, the whole arena should be one hole again
+bool arenaIsEmpty(MemoryManager& memoryManager, size_t sizeInWords) {
+	uint64_t* holeList = static_cast<uint64_t*>(memoryManager.getWideList());
+	bool empty = holeList[0] == 1 && holeList[1] == 0 && holeList[2] == sizeInWords;
+	std::free(holeList);
+	return empty;
+}
+
+//a pattern that depends on the position and the seed, so a block copied to the wrong place or shifted by a byte doesn't match
+void fillBlock(void* block, size_t sizeInBytes, uint8_t seed) {
+	uint8_t* bytes = static_cast<uint8_t*>(block);
+	for (size_t i = 0; i < sizeInBytes; i++) bytes[i] = static_cast<uint8_t>(seed + i * 7);
+}
+
+bool checkBlock(void* block, size_t sizeInBytes, uint8_t seed) {
+	uint8_t* bytes = static_cast<uint8_t*>(block);
+	for (size_t i = 0; i < sizeInBytes; i++) {
+		if (bytes[i] != static_cast<uint8_t>(seed + i * 7)) return false;
+	}
+	return true;
+}
+
+//an arena past SIZE_LIMIT only with wide offsets on, and then only the wide list and bitmap can describe it
+unsigned int testWideOffsets() {
+	std::cout << "Test: wide offsets" << std::endl;
+	size_t arenaWords = 100000;
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.initialize(arenaWords);
+	bool passed = memoryManager.getMemoryStart() == nullptr;
+	//too big without wide offsets, so it stays uninitialized
+
+	memoryManager.setWideOffsets(true);
+	memoryManager.initialize(arenaWords);
+	void* first = memoryManager.allocate(70000 * 8);
+	void* second = memoryManager.allocate(10 * 8);
+	void* third = memoryManager.allocate(5 * 8);
+	memoryManager.free(second);
+	passed = passed && first != nullptr && second != nullptr && third != nullptr;
+	passed = passed && memoryManager.getList() == nullptr && memoryManager.getBitmap() == nullptr;
+
+	uint64_t* holeList = static_cast<uint64_t*>(memoryManager.getWideList());
+	passed = passed && holeList[0] == 2 && holeList[1] == 70000 && holeList[2] == 10 && holeList[3] == 70015 && holeList[4] == arenaWords - 70015;
+	std::free(holeList);
+
+	uint8_t* bitmap = static_cast<uint8_t*>(memoryManager.getWideBitmap());
+	uint64_t bitmapBytes = 0;
+	for (int i = 0; i < 8; i++) bitmapBytes |= static_cast<uint64_t>(bitmap[i]) << (8 * i);
+	uint8_t* bits = bitmap + 8;
+	auto bit = [&](size_t word) { return (bits[word / 8] >> (word % 8)) & 1; };
+	passed = passed && bitmapBytes == arenaWords / 8 && bit(0) && bit(69999) && !bit(70000) && !bit(70009) && bit(70010) && bit(70014) && !bit(70015) && !bit(arenaWords - 1);
+	std::free(bitmap);
+
+	memoryManager.free(first);
+	memoryManager.free(third);
+	passed = passed && arenaIsEmpty(memoryManager, arenaWords);
+	if (!passed) std::cout << "Failed: wide list, wide bitmap or the limit check" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//random allocates and frees, checking every block still holds what was written to it and the arena ends up whole again
+//the arena is mmap backed and gives free pages back as it goes, so anything an engine keeps inside its free blocks has to survive that
+unsigned int testEngineChurn(ArenaEngine engine, unsigned wordSize) {
+	std::cout << "Test: allocate and free churn, " << engineName(engine) << " engine, word size " << wordSize << std::endl;
+	size_t arenaWords = 60000;
+	MemoryManager memoryManager(wordSize, BEST_FIT);
+	memoryManager.setMmapBacking(true);
+	memoryManager.setPageRelease(4096);
+	memoryManager.initialize(arenaWords, engine);
+
+	std::mt19937 random(3);
+	std::vector<TestBlock> blocks;
+	int corruptBlocks = 0;
+	int misplacedBlocks = 0;
+	for (int i = 0; i < 20000; i++) {
+		if (blocks.empty() || random() % 3 != 0) {
+			size_t size = random() % 4 == 0 ? random() % 2000 + 1 : random() % 64 + 1;
+			void* block = memoryManager.allocate(size);
+			if (block == nullptr) continue;
+			if (memoryManager.getAllocationStart(block) != block || memoryManager.getAllocationSize(block) < size) misplacedBlocks++;
+			if (memoryManager.getAllocationStart(static_cast<char*>(block) + size - 1) != block) misplacedBlocks++;
+			fillBlock(block, size, static_cast<uint8_t>(i));
+			blocks.push_back({block, size, static_cast<uint8_t>(i)});
+			continue;
+		}
+		size_t index = random() % blocks.size();
+		if (!checkBlock(blocks[index].address, blocks[index].sizeInBytes, blocks[index].seed)) corruptBlocks++;
+		memoryManager.free(blocks[index].address);
+		blocks[index] = blocks.back();
+		blocks.pop_back();
+		if (i % 500 == 0) memoryManager.releaseFreePages();
+	}
+
+	for (TestBlock& block : blocks) memoryManager.free(block.address);
+	memoryManager.releaseFreePages();
+	//every page is free now, including the first one, where the free block covering the whole arena starts
+	bool passed = corruptBlocks == 0 && misplacedBlocks == 0 && memoryManager.isEmpty();
+	if (engine != BUDDY_ENGINE) passed = passed && arenaIsEmpty(memoryManager, arenaWords);
+	//60000 isn't a power of two, so an empty buddy arena is still several free blocks
+	if (!passed) std::cout << "Failed: " << corruptBlocks << " corrupt blocks, " << misplacedBlocks << " with the wrong start or size" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//buddy blocks are powers of two, lined up on their own size, and freeing both halves merges them back
+unsigned int testBuddyBlocks() {
+	std::cout << "Test: buddy block sizes and merging" << std::endl;
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.initialize(1024, BUDDY_ENGINE);
+
+	bool passed = true;
+	std::vector<void*> blocks;
+	for (size_t words : {1, 3, 5, 17, 100}) {
+		void* block = memoryManager.allocate(words * 8);
+		size_t offset = (static_cast<char*>(block) - static_cast<char*>(memoryManager.getMemoryStart())) / 8;
+		size_t length = memoryManager.getAllocationSize(block) / 8;
+		passed = passed && block != nullptr && (length & (length - 1)) == 0 && length >= words && length < words * 2 && offset % length == 0;
+		blocks.push_back(block);
+	}
+	passed = passed && memoryManager.allocate(2048 * 8) == nullptr;
+	for (void* block : blocks) memoryManager.free(block);
+	passed = passed && memoryManager.isEmpty() && arenaIsEmpty(memoryManager, 1024);
+	if (!passed) std::cout << "Failed: a block wasn't a lined up power of two, or the buddies didn't merge back" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//the built in strategies pick the same holes the original list allocators would
+unsigned int testFitStrategies() {
+	std::cout << "Test: best, worst and first fit" << std::endl;
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.initialize(200);
+	std::vector<void*> blocks;
+	for (size_t words : {10, 1, 4, 1, 30, 1, 6, 1, 20, 1}) blocks.push_back(memoryManager.allocate(words * 8));
+	for (int i = 0; i < 10; i += 2) memoryManager.free(blocks[i]);
+	//holes of 10, 4, 30, 6 and 20 words at 0, 11, 16, 47 and 54, plus the 125 left at 75. each check frees what it took, so they all see this
+	char* start = static_cast<char*>(memoryManager.getMemoryStart());
+
+	auto offsetOf = [&](FitStrategy strategy, size_t words) {
+		memoryManager.setFitStrategy(strategy);
+		char* block = static_cast<char*>(memoryManager.allocate(words * 8));
+		memoryManager.free(block);
+		return block == nullptr ? -1 : static_cast<int64_t>((block - start) / 8);
+	};
+	bool passed = offsetOf(BEST_FIT, 5) == 47 && offsetOf(BEST_FIT, 4) == 11 && offsetOf(BEST_FIT, 21) == 16;
+	//5 goes in the 6, 4 fits the 4 exactly, and 21 in the 30 rather than the bigger one at the end
+	passed = passed && offsetOf(WORST_FIT, 1) == 75 && offsetOf(FIRST_FIT, 5) == 0 && offsetOf(FIRST_FIT, 11) == 16 && offsetOf(FIRST_FIT, 31) == 75;
+	passed = passed && offsetOf(FIRST_FIT, 126) == -1 && offsetOf(BITMAP_FIRST_FIT, 11) == 16;
+
+	std::mt19937 random(7);
+	std::vector<void*> churn;
+	for (int i = 0; i < 3000; i++) {
+		if (churn.empty() || random() % 5 < 3) {
+			size_t words = random() % 12 + 1;
+			uint64_t* holeList = static_cast<uint64_t*>(memoryManager.getWideList());
+			int64_t expected = -1;
+			for (uint64_t h = 0; h < holeList[0] && expected < 0; h++) {
+				if (holeList[2 + h * 2] >= words) expected = holeList[1 + h * 2];
+			}
+			std::free(holeList);
+			memoryManager.setFitStrategy(FIRST_FIT);
+			char* block = static_cast<char*>(memoryManager.allocate(words * 8));
+			passed = passed && (block == nullptr ? -1 : (block - start) / 8) == expected;
+			if (block != nullptr) churn.push_back(block);
+		}
+		else {
+			size_t index = random() % churn.size();
+			memoryManager.free(churn[index]);
+			churn[index] = churn.back();
+			churn.pop_back();
+		}
+		if (i % 500 == 0) memoryManager.setFitStrategy(BEST_FIT);
+		//switching away drops the first fit index and switching back builds it again, so do that along the way too
+	}
+	for (void* block : churn) memoryManager.free(block);
+	//first fit always takes the lowest hole that's big enough, the same one a walk through the list would
+
+	memoryManager.setViewAllocator(worstFitView);
+	passed = passed && memoryManager.getFitStrategy() == CUSTOM_VIEW_FIT && offsetOf(CUSTOM_VIEW_FIT, 1) == 75;
+	memoryManager.setFitStrategy(FIRST_FIT);
+	memoryManager.setViewAllocator(std::function<int64_t(size_t, const HoleView&)>());
+	memoryManager.setWideAllocator(std::function<int64_t(size_t, void*)>());
+	passed = passed && memoryManager.getFitStrategy() == FIRST_FIT && memoryManager.allocate(8) != nullptr;
+	//an empty allocator is turned down, rather than switched to and then called
+	if (!passed) std::cout << "Failed: a strategy picked the wrong hole" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//the live bitmap and the queries on it agree with a map of the arena built by hand from the blocks handed out
+unsigned int testLiveBitmap() {
+	std::cout << "Test: live bitmap queries" << std::endl;
+	size_t arenaWords = 3000;
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.initialize(arenaWords);
+	bool passed = memoryManager.getLiveBitmap() == nullptr && memoryManager.findFreeRun(1) == -1 && memoryManager.countFreeWords(0, arenaWords) == 0;
+	//nothing to answer from until it's turned on
+	memoryManager.setLiveBitmap(true);
+	char* start = static_cast<char*>(memoryManager.getMemoryStart());
+
+	std::vector<bool> allocated(arenaWords, false);
+	auto mark = [&](void* block, bool isAllocated) {
+		size_t offset = (static_cast<char*>(block) - start) / 8;
+		size_t length = memoryManager.getAllocationSize(block) / 8;
+		for (size_t word = offset; word < offset + length; word++) allocated[word] = isAllocated;
+	};
+	auto expectedRun = [&](size_t sizeInWords, size_t startWord) {
+		size_t run = 0;
+		for (size_t word = startWord; word < arenaWords; word++) {
+			run = allocated[word] ? 0 : run + 1;
+			if (run == std::max(sizeInWords, static_cast<size_t>(1))) return static_cast<int64_t>(word + 1 - run);
+		}
+		return static_cast<int64_t>(-1);
+	};
+
+	std::mt19937 random(11);
+	std::vector<void*> blocks;
+	for (int i = 0; i < 2000; i++) {
+		if (blocks.empty() || random() % 5 < 3) {
+			void* block = memoryManager.allocate((random() % 40 + 1) * 8);
+			if (block != nullptr) {
+				mark(block, true);
+				blocks.push_back(block);
+			}
+		}
+		else {
+			size_t index = random() % blocks.size();
+			mark(blocks[index], false);
+			memoryManager.free(blocks[index]);
+			blocks[index] = blocks.back();
+			blocks.pop_back();
+		}
+		if (i % 50 != 0) continue;
+
+		const uint8_t* bits = memoryManager.getLiveBitmap();
+		passed = passed && memoryManager.getLiveBitmapSize() == (arenaWords + 7) / 8;
+		for (size_t word = 0; word < arenaWords; word++) passed = passed && ((bits[word / 8] >> (word % 8)) & 1) == allocated[word];
+		for (int query = 0; query < 20; query++) {
+			size_t sizeInWords = query % 4 == 0 ? random() % 200 : random() % 20 + 1;
+			size_t startWord = random() % arenaWords;
+			passed = passed && memoryManager.findFreeRun(sizeInWords, startWord) == expectedRun(sizeInWords, startWord);
+			size_t beginWord = random() % arenaWords;
+			size_t endWord = beginWord + random() % 300;
+			size_t freeWords = 0;
+			for (size_t word = beginWord; word < std::min(endWord, arenaWords); word++) freeWords += allocated[word] ? 0 : 1;
+			passed = passed && memoryManager.countFreeWords(beginWord, endWord) == freeWords;
+		}
+		//runs of every length, including ones longer than a 64 bit word and ones that start partway into one
+	}
+	passed = passed && memoryManager.findFreeRun(1, arenaWords) == -1;
+	for (void* block : blocks) memoryManager.free(block);
+	passed = passed && memoryManager.findFreeRun(arenaWords) == 0 && memoryManager.countFreeWords(0, arenaWords) == arenaWords;
+	memoryManager.setLiveBitmap(false);
+	passed = passed && memoryManager.getLiveBitmap() == nullptr;
+	if (!passed) std::cout << "Failed: the live bitmap or a query on it didn't match the blocks handed out" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//every alignment lands on a multiple of itself, keeps what's written to it, and frees back to an empty arena
+unsigned int testAlignedAllocate(ArenaEngine engine) {
+	std::cout << "Test: aligned allocate, " << engineName(engine) << " engine" << std::endl;
+	size_t arenaWords = 16384;
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.initialize(arenaWords, engine);
+
+	bool passed = memoryManager.allocate(8, 3) == nullptr && memoryManager.allocate(8, 0) == nullptr;
+	passed = passed && memoryManager.allocate(SIZE_MAX, 8) == nullptr && memoryManager.allocate(SIZE_MAX - 2, 64) == nullptr;
+	passed = passed && memoryManager.allocate(arenaWords * 8 + 1, 8) == nullptr && memoryManager.getTelemetry().failedAllocations == 3;
+	memoryManager.setThreadSafe(true);
+	passed = passed && memoryManager.allocate(SIZE_MAX) == nullptr && memoryManager.getTelemetry().failedAllocations == 4;
+	memoryManager.setThreadSafe(false);
+	passed = passed && memoryManager.isEmpty();
+	//adding the padding or rounding up to words wraps sizes this close to SIZE_MAX round to tiny ones, which mustn't get a block
+	std::vector<TestBlock> blocks;
+	std::mt19937 random(5);
+	for (int i = 0; i < 200; i++) {
+		size_t alignment = static_cast<size_t>(1) << (random() % 10);
+		size_t size = random() % 200 + 1;
+		void* block = memoryManager.allocate(size, alignment);
+		if (block == nullptr) continue;
+		passed = passed && reinterpret_cast<uintptr_t>(block) % alignment == 0 && memoryManager.getAllocationSize(block) >= size;
+		char* blockStart = static_cast<char*>(memoryManager.getAllocationStart(block));
+		passed = passed && static_cast<char*>(block) + memoryManager.getAllocationSize(block) == blockStart + memoryManager.getAllocationSize(blockStart);
+		//on the engines that pad in front, the size from the aligned pointer ends where the size from the real start does
+		fillBlock(block, size, static_cast<uint8_t>(i));
+		blocks.push_back({block, size, static_cast<uint8_t>(i)});
+	}
+	for (TestBlock& block : blocks) passed = passed && checkBlock(block.address, block.sizeInBytes, block.seed);
+	for (TestBlock& block : blocks) memoryManager.free(block.address);
+	passed = passed && blocks.size() > 100 && memoryManager.isEmpty();
+	if (engine != BUDDY_ENGINE) passed = passed && arenaIsEmpty(memoryManager, arenaWords);
+	if (!passed) std::cout << "Failed: a block wasn't aligned, or didn't free" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//grows and shrinks keep the contents, in place when there's room after the block, and a failed grow leaves the block alone
+unsigned int testReallocate(ArenaEngine engine) {
+	std::cout << "Test: reallocate, " << engineName(engine) << " engine" << std::endl;
+	size_t arenaWords = 4096;
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.initialize(arenaWords, engine);
+
+	void* block = memoryManager.reallocate(nullptr, 40);
+	fillBlock(block, 40, 1);
+	void* grown = memoryManager.reallocate(block, 120);
+	bool passed = block != nullptr && grown == block && checkBlock(grown, 40, 1);
+	//nothing after it yet, so it grows where it is
+	fillBlock(grown, 120, 2);
+
+	void* blocker = memoryManager.allocate(8);
+	void* moved = memoryManager.reallocate(grown, 1000);
+	passed = passed && moved != nullptr && moved != grown && checkBlock(moved, 120, 2);
+	void* shrunk = memoryManager.reallocate(moved, 24);
+	passed = passed && shrunk == moved && checkBlock(shrunk, 24, 2) && memoryManager.getAllocationSize(shrunk) == (engine == BUDDY_ENGINE ? 32 : 24);
+	//buddy blocks only come in powers of two, so 24 bytes is still a 4 word block
+
+	void* tooBig = memoryManager.reallocate(shrunk, arenaWords * 8 * 2);
+	passed = passed && tooBig == nullptr && checkBlock(shrunk, 24, 2) && memoryManager.getAllocationStart(shrunk) == shrunk;
+	void* wrapped = memoryManager.reallocate(shrunk, SIZE_MAX);
+	passed = passed && wrapped == nullptr && checkBlock(shrunk, 24, 2) && memoryManager.getAllocationSize(shrunk) == (engine == BUDDY_ENGINE ? 32 : 24);
+	//rounded up to words, SIZE_MAX wraps round to nothing, which would shrink the block instead of failing
+	ReallocationStats stats = memoryManager.getReallocationStats();
+	passed = passed && stats.failed == 2 && stats.moved == 1 && stats.inPlace == 2;
+
+	passed = passed && memoryManager.reallocate(shrunk, 0) == nullptr;
+	memoryManager.free(blocker);
+	passed = passed && memoryManager.isEmpty();
+
+	void* before = memoryManager.allocate(8);
+	void* aligned = memoryManager.allocate(40, 64);
+	fillBlock(aligned, 40, 3);
+	void* alignedGrown = memoryManager.reallocate(aligned, 41);
+	passed = passed && alignedGrown != nullptr && reinterpret_cast<uintptr_t>(alignedGrown) % 64 == 0 && checkBlock(alignedGrown, 40, 3);
+	void* alignedMoved = memoryManager.reallocate(alignedGrown, 1000);
+	passed = passed && alignedMoved != nullptr && reinterpret_cast<uintptr_t>(alignedMoved) % 64 == 0 && checkBlock(alignedMoved, 40, 3);
+	fillBlock(alignedMoved, 1000, 4);
+	passed = passed && memoryManager.reallocate(alignedMoved, SIZE_MAX - 8) == nullptr && checkBlock(alignedMoved, 1000, 4);
+	void* alignedShrunk = memoryManager.reallocate(alignedMoved, 20);
+	passed = passed && alignedShrunk == alignedMoved && memoryManager.getAllocationSize(alignedShrunk) >= 20 && checkBlock(alignedShrunk, 20, 4);
+	//the block in front means buddy and TLSF have to pad the aligned block, so the pointer isn't the block's start.
+	//the contents have to follow the pointer, not the block, and stay lined up wherever it moves
+	memoryManager.free(alignedShrunk);
+	memoryManager.free(before);
+	passed = passed && memoryManager.isEmpty();
+	if (!passed) std::cout << "Failed: contents lost, or resized in the wrong place" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//compact slides handle blocks down past the holes below them, but never a normal block, and the handles follow their blocks
+unsigned int testHandlesAndCompaction() {
+	std::cout << "Test: handles and compaction" << std::endl;
+	size_t arenaWords = 1000;
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.initialize(arenaWords);
+
+	std::vector<uint64_t> handles;
+	for (int i = 0; i < 20; i++) {
+		uint64_t handle = memoryManager.allocateHandle(80);
+		fillBlock(memoryManager.resolveHandle(handle), 80, static_cast<uint8_t>(i));
+		handles.push_back(handle);
+	}
+	void* pinned = memoryManager.allocate(80);
+	uint64_t pastPinned = memoryManager.allocateHandle(80);
+	fillBlock(memoryManager.resolveHandle(pastPinned), 80, 99);
+	for (int i = 0; i < 20; i += 2) memoryManager.freeHandle(handles[i]);
+	//ten 10 word holes between the live handle blocks, then the pinned block, then one more handle block
+
+	bool passed = memoryManager.resolveHandle(handles[0]) == nullptr;
+	memoryManager.freeHandle(handles[0]);
+	//freeing it again does nothing
+
+	CompactionReport report = memoryManager.compact();
+	passed = passed && report.finished && report.blocksMoved == 10 && report.holesBefore == 11 && report.holesAfter == 2;
+	for (int i = 1; i < 20; i += 2) {
+		void* block = memoryManager.resolveHandle(handles[i]);
+		size_t offset = (static_cast<char*>(block) - static_cast<char*>(memoryManager.getMemoryStart())) / 8;
+		passed = passed && offset == static_cast<size_t>(i / 2 * 10) && checkBlock(block, 80, static_cast<uint8_t>(i));
+	}
+	passed = passed && memoryManager.getAllocationStart(pinned) == pinned && checkBlock(memoryManager.resolveHandle(pastPinned), 80, 99);
+	//the hole under the pinned block stays, and the block past it has no hole under it to move into
+
+	for (int i = 1; i < 20; i += 2) memoryManager.freeHandle(handles[i]);
+	memoryManager.free(memoryManager.resolveHandle(pastPinned));
+	passed = passed && memoryManager.resolveHandle(pastPinned) == nullptr;
+	memoryManager.free(pinned);
+	passed = passed && arenaIsEmpty(memoryManager, arenaWords);
+	if (!passed) std::cout << "Failed: a block moved wrong, or a handle didn't follow it" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//the running counts agree with what the hole list says
+unsigned int testTelemetry(ArenaEngine engine) {
+	std::cout << "Test: telemetry, " << engineName(engine) << " engine" << std::endl;
+	size_t arenaWords = 8192;
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.initialize(arenaWords, engine);
+
+	std::mt19937 random(9);
+	std::vector<void*> blocks;
+	bool passed = true;
+	for (int i = 0; i < 3000; i++) {
+		if (blocks.empty() || random() % 2 == 0) {
+			void* block = memoryManager.allocate((random() % 60 + 1) * 8);
+			if (block != nullptr) blocks.push_back(block);
+		}
+		else {
+			size_t index = random() % blocks.size();
+			memoryManager.free(blocks[index]);
+			blocks[index] = blocks.back();
+			blocks.pop_back();
+		}
+		if (i % 100 != 0) continue;
+
+		MemoryTelemetry telemetry = memoryManager.getTelemetry();
+		uint64_t* holeList = static_cast<uint64_t*>(memoryManager.getWideList());
+		size_t freeWords = 0;
+		size_t largestHole = 0;
+		for (uint64_t h = 0; h < holeList[0]; h++) {
+			freeWords += holeList[2 + h * 2];
+			largestHole = std::max(largestHole, static_cast<size_t>(holeList[2 + h * 2]));
+		}
+		passed = passed && telemetry.freeWords == freeWords;
+		if (engine == HOLE_MAP_ENGINE) passed = passed && telemetry.holeCount == holeList[0] && telemetry.largestHole == largestHole;
+		else if (engine == TLSF_ENGINE) passed = passed && telemetry.holeCount == holeList[0] && telemetry.largestHole <= largestHole && telemetry.largestHole * 17 >= largestHole * 16;
+		else passed = passed && telemetry.holeCount >= holeList[0] && telemetry.largestHole <= largestHole;
+		//the list merges free buddy blocks that sit side by side, telemetry counts them as the engine keeps them
+		//TLSF only knows its largest block to within its size class some of the time, and a class is 1/16th wide
+		std::free(holeList);
+	}
+	for (void* block : blocks) memoryManager.free(block);
+	MemoryTelemetry telemetry = memoryManager.getTelemetry();
+	passed = passed && telemetry.freeWords == arenaWords && telemetry.allocations == telemetry.frees;
+	if (!passed) std::cout << "Failed: telemetry doesn't match the hole list" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//the JSON has every telemetry field with the same value getTelemetry gives, and a histogram that stops at the last bucket in use
+unsigned int testTelemetryJson() {
+	std::cout << "Test: telemetry JSON" << std::endl;
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.initialize(5000);
+	std::vector<void*> blocks;
+	for (size_t words : {3, 100, 7, 900, 1, 40, 2}) blocks.push_back(memoryManager.allocate(words * 8));
+	memoryManager.free(blocks[1]);
+	memoryManager.free(blocks[3]);
+	memoryManager.free(blocks[5]);
+	memoryManager.allocate(6000 * 8);
+	//holes of 100, 900 and 40 words, the rest at the end, and one failure
+
+	std::string json = memoryManager.getTelemetryJson();
+	MemoryTelemetry telemetry = memoryManager.getTelemetry();
+	auto field = [&](const std::string& name) {
+		size_t at = json.find("\"" + name + "\": ");
+		return at == std::string::npos ? -1.0 : std::strtod(json.c_str() + at + name.size() + 4, nullptr);
+	};
+	bool passed = json.front() == '{' && json.back() == '}' && json.find('\n') == std::string::npos;
+	passed = passed && field("wordSize") == 8 && field("arenaWords") == telemetry.arenaWords && field("freeWords") == telemetry.freeWords;
+	passed = passed && field("largestHole") == telemetry.largestHole && field("holeCount") == 4 && field("allocations") == 7;
+	passed = passed && field("frees") == 3 && field("failedAllocations") == 1 && std::abs(field("fragmentation") - telemetry.fragmentation) < 0.00001;
+
+	size_t histogramStart = json.find("\"holeSizeHistogram\": [");
+	size_t histogramEnd = json.find(']', histogramStart);
+	std::vector<size_t> histogram;
+	for (size_t at = histogramStart + 22; histogramStart != std::string::npos && at < histogramEnd; ) {
+		char* numberEnd;
+		histogram.push_back(std::strtoul(json.c_str() + at, &numberEnd, 10));
+		at = numberEnd - json.c_str() + 2;	//past the ", " (or the "]" after the last one, which ends it)
+	}
+	passed = passed && histogram.size() == 12 && histogram[5] == 1 && histogram[6] == 1 && histogram[9] == 1 && histogram[11] == 1;
+	//40 is in [32, 64), 100 in [64, 128), 900 in [512, 1024) and the 3947 at the end in [2048, 4096), which is the last one shown
+	if (!passed) std::cout << "Failed: the JSON didn't match getTelemetry" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//the trace file has a record for every call made between startTrace and stopTrace, failures included, with ids that follow the blocks
+unsigned int testTrace() {
+	std::cout << "Test: trace recording" << std::endl;
+	char filename[] = "featureTestTrace.bin";
+	char badFilename[] = "no/such/directory/trace.bin";
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.initialize(2000);
+	bool passed = memoryManager.startTrace(badFilename) == -1;
+
+	void* early = memoryManager.allocate(16);
+	passed = passed && memoryManager.startTrace(filename) == 0;
+	void* first = memoryManager.allocate(40);
+	void* aligned = memoryManager.allocate(100, 64);
+	memoryManager.allocate(3000 * 8);
+	void* moved = memoryManager.reallocate(first, 400);
+	memoryManager.free(static_cast<char*>(aligned) + 50);
+	memoryManager.free(early);
+	memoryManager.free(moved);
+	passed = passed && memoryManager.stopTrace() == 0;
+	memoryManager.free(memoryManager.allocate(8));
+	//the early block was allocated before the trace started, and the last two calls come after it stopped, so none of them are in it
+
+	std::vector<uint64_t> records;
+	FILE* traceFile = std::fopen(filename, "rb");
+	char magic[8];
+	passed = passed && traceFile != nullptr && std::fread(magic, 1, 8, traceFile) == 8 && memcmp(magic, TRACE_MAGIC, 8) == 0;
+	uint64_t value = 0;
+	int shift = 0;
+	for (int byte = traceFile == nullptr ? EOF : std::fgetc(traceFile); byte != EOF; byte = std::fgetc(traceFile)) {
+		value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+		shift += 7;
+		if (byte & 0x80) continue;
+		records.push_back(value);
+		value = 0;
+		shift = 0;
+	}
+	if (traceFile != nullptr) std::fclose(traceFile);
+	unlink(filename);
+	//the events all fit in one byte, so every field (the word size and events included) reads back as a varint
+
+	std::vector<uint64_t> expected = {8,
+		TRACE_ALLOCATE, 0, 1, 40,
+		TRACE_ALIGNED_ALLOCATE, 0, 2, 100, 64,
+		TRACE_ALLOCATE, 0, 3, 3000 * 8,
+		TRACE_REALLOCATE, 0, 1, 4, 400,
+		TRACE_FREE, 0, 2,
+		TRACE_FREE, 0, 4};
+	passed = passed && records == expected;
+	//the failed allocate still gets an id, the free through a pointer partway into the aligned block finds it,
+	//and the reallocated block goes by its new id from then on
+	if (!passed) std::cout << "Failed: the trace didn't record the calls made while it was on" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//small blocks go through the thread caches, which hold on to freed blocks until they're flushed or their thread exits
+//the threads only check what's in their own blocks. ConcurrencyTest is the one that looks for races, under ThreadSanitizer
+unsigned int testThreadSafe() {
+	std::cout << "Test: thread safe mode" << std::endl;
+	size_t arenaWords = 20000;
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.initialize(arenaWords);
+	memoryManager.setThreadSafe(true);
+	bool passed = memoryManager.isThreadSafe();
+
+	void* small = memoryManager.allocate(16);
+	passed = passed && small != nullptr && memoryManager.getTelemetry().allocations == THREAD_CACHE_BATCH;
+	//the first one takes a whole batch into this thread's cache
+	memoryManager.free(small);
+	passed = passed && !memoryManager.isEmpty();
+	memoryManager.flushThreadCache();
+	passed = passed && memoryManager.isEmpty();
+	//freed into the cache, so the arena still counts it until the cache is flushed
+
+	std::vector<std::thread> threads;
+	std::atomic<int> corruptBlocks(0);
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&memoryManager, &corruptBlocks, t]() {
+			std::mt19937 random(t);
+			std::vector<TestBlock> blocks;
+			for (int i = 0; i < 5000; i++) {
+				if (blocks.empty() || random() % 3 != 0) {
+					size_t size = random() % 8 == 0 ? random() % 1000 + 1 : random() % (THREAD_CACHE_MAX_WORDS * 8) + 1;
+					void* block = memoryManager.allocate(size);
+					if (block == nullptr) continue;
+					fillBlock(block, size, static_cast<uint8_t>(i));
+					blocks.push_back({block, size, static_cast<uint8_t>(i)});
+					continue;
+				}
+				size_t index = random() % blocks.size();
+				if (!checkBlock(blocks[index].address, blocks[index].sizeInBytes, blocks[index].seed)) corruptBlocks++;
+				memoryManager.free(blocks[index].address);
+				blocks[index] = blocks.back();
+				blocks.pop_back();
+			}
+			for (TestBlock& block : blocks) memoryManager.free(block.address);
+		});
+	}
+	for (std::thread& thread : threads) thread.join();
+	passed = passed && corruptBlocks == 0 && memoryManager.isEmpty() && arenaIsEmpty(memoryManager, arenaWords);
+	//each thread's cache went back to the arena as it exited
+
+	small = memoryManager.allocate(16);
+	memoryManager.initialize(arenaWords);
+	void* afterReset = memoryManager.allocate(16);
+	passed = passed && afterReset != nullptr && memoryManager.getAllocationStart(afterReset) == afterReset;
+	//the cache still had blocks from the old arena, which have to be thrown out rather than handed back
+	memoryManager.free(afterReset);
+	memoryManager.setThreadSafe(false);
+	passed = passed && !memoryManager.isThreadSafe() && memoryManager.isEmpty() && arenaIsEmpty(memoryManager, arenaWords);
+	//switching it off flushes this thread's cache
+	if (!passed) std::cout << "Failed: a block was overwritten, or the caches didn't give their blocks back" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//blocks another thread hands back with freeRemote stay allocated until the owner next touches the arena, then they're freed
+//with words smaller than a pointer the stack is made of nodes from the heap instead of the blocks themselves
+unsigned int testRemoteFree(unsigned wordSize) {
+	std::cout << "Test: remote frees, word size " << wordSize << std::endl;
+	size_t arenaWords = 4000;
+	MemoryManager memoryManager(wordSize, BEST_FIT);
+	memoryManager.initialize(arenaWords);
+
+	std::vector<TestBlock> blocks;
+	for (int i = 0; i < 200; i++) {
+		size_t size = i % 7 + 1;
+		void* block = memoryManager.allocate(size * wordSize);
+		fillBlock(block, size * wordSize, static_cast<uint8_t>(i));
+		blocks.push_back({block, size * wordSize, static_cast<uint8_t>(i)});
+	}
+	std::thread remote([&memoryManager, &blocks]() {
+		for (size_t i = 0; i < blocks.size(); i += 2) {
+			void* address = static_cast<char*>(blocks[i].address) + (blocks[i].sizeInBytes - 1) / 2;
+			memoryManager.freeRemote(address);
+		}
+		memoryManager.freeRemote(nullptr);
+	});
+	remote.join();
+	//any pointer into a block works, the same as for free
+
+	bool passed = memoryManager.getAllocationStart(blocks[0].address) == nullptr;
+	//the owner's next call catches up on the remote frees first
+	for (size_t i = 1; i < blocks.size(); i += 2) passed = passed && checkBlock(blocks[i].address, blocks[i].sizeInBytes, blocks[i].seed);
+	for (size_t i = 1; i < blocks.size(); i += 2) memoryManager.freeRemote(blocks[i].address);
+	passed = passed && memoryManager.isEmpty() && arenaIsEmpty(memoryManager, arenaWords);
+	if (!passed) std::cout << "Failed: remote frees weren't done, or freed the wrong blocks" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//objects come out of slabs in the manager's arena, and empty slabs go back to it
+unsigned int testSlabAllocator() {
+	std::cout << "Test: slab allocator" << std::endl;
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.initialize(20000);
+	bool passed = true;
+	{
+		SlabAllocator slabs(memoryManager, 1000);
+		passed = slabs.addSizeClass(16) == 0 && slabs.addSizeClass(48) == 1 && slabs.addSizeClass(2000) == -1;
+		//1000 byte slabs are rounded up to 1024, so they can be aligned to their size
+
+		std::vector<TestBlock> objects;
+		for (int i = 0; i < 500; i++) {
+			size_t size = i % 2 == 0 ? 16 : 40;
+			void* object = slabs.allocate(size);
+			fillBlock(object, size, static_cast<uint8_t>(i));
+			objects.push_back({object, size, static_cast<uint8_t>(i)});
+		}
+		void* large = slabs.allocate(400);
+		passed = passed && large != nullptr && memoryManager.getAllocationStart(large) == large;
+		for (TestBlock& object : objects) passed = passed && checkBlock(object.address, object.sizeInBytes, object.seed);
+
+		SlabStats stats = slabs.getStats();
+		passed = passed && stats.slabBytes % 1024 == 0 && stats.classes[0].objectsPerSlab == 64 && stats.classes[0].liveObjects == 250 && stats.classes[1].liveObjects == 250 && stats.passThroughAllocations == 1;
+		for (TestBlock& object : objects) slabs.free(static_cast<char*>(object.address) + object.sizeInBytes - 1);
+		slabs.free(large);
+		//a pointer to the last byte of an object still finds its slab, even when that's the slab's last byte
+		slabs.releaseEmptySlabs();
+		passed = passed && slabs.getStats().slabBytes == 0;
+	}
+	passed = passed && memoryManager.isEmpty();
+	if (!passed) std::cout << "Failed: objects overlapped, or slabs weren't given back" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//a chain of arenas adds one when nothing fits, and lets go of the ones that empty out
+unsigned int testGrowable() {
+	std::cout << "Test: growable arenas" << std::endl;
+	GrowableMemoryManager memoryManager(8, BEST_FIT, 1024);
+	std::vector<TestBlock> blocks;
+	for (int i = 0; i < 100; i++) {
+		void* block = memoryManager.allocate(400);
+		fillBlock(block, 400, static_cast<uint8_t>(i));
+		blocks.push_back({block, 400, static_cast<uint8_t>(i)});
+	}
+	void* huge = memoryManager.allocate(5000 * 8);
+	bool passed = huge != nullptr && memoryManager.getAllocationSize(huge) == 5000 * 8 && memoryManager.getStats().arenas > 5;
+	for (TestBlock& block : blocks) passed = passed && checkBlock(block.address, block.sizeInBytes, block.seed) && memoryManager.getAllocationStart(block.address) == block.address;
+
+	memoryManager.setMaxArenas(memoryManager.getStats().arenas);
+	passed = passed && memoryManager.allocate(5000 * 8) == nullptr && memoryManager.getStats().failedAllocations == 1;
+	for (TestBlock& block : blocks) memoryManager.free(block.address);
+	memoryManager.free(huge);
+	passed = passed && memoryManager.getStats().arenas == 1;
+	//the first one to empty out is kept as the spare
+	memoryManager.releaseEmptyArenas();
+	passed = passed && memoryManager.getStats().arenas == 0;
+
+	for (ArenaEngine engine : {HOLE_MAP_ENGINE, BUDDY_ENGINE, TLSF_ENGINE}) {
+		GrowableMemoryManager chain(8, BEST_FIT, 1024, engine);
+		void* whole = chain.allocate(1024 * 8);
+		void* bigger = chain.allocate(4096 * 8);
+		void* odd = chain.allocate(3000 * 8 + 1);
+		passed = passed && whole != nullptr && bigger != nullptr && odd != nullptr && chain.getStats().failedAllocations == 0;
+		passed = passed && chain.getAllocationSize(whole) >= 1024 * 8 && chain.getAllocationSize(odd) >= 3000 * 8 + 1;
+	}
+	//a request as big as an arena or bigger gets an arena with room for whatever the engine keeps around the block
+	if (!passed) std::cout << "Failed: arenas weren't added or released" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//blocks and their contents are still there when the heap file is opened again, by offset handle rather than pointer
+unsigned int testPersistentHeap() {
+	std::cout << "Test: persistent heap" << std::endl;
+	char filename[] = "featureTestHeap.bin";
+	unlink(filename);
+	uint64_t firstHandle;
+	uint64_t secondHandle;
+	bool passed = true;
+	{
+		MemoryManager memoryManager(8, BEST_FIT);
+		passed = memoryManager.initializeFromFile(filename, 2000) == 0;
+		void* first = memoryManager.allocate(100);
+		void* gap = memoryManager.allocate(64);
+		void* second = memoryManager.allocate(300);
+		memoryManager.free(gap);
+		fillBlock(first, 100, 1);
+		fillBlock(second, 300, 2);
+		firstHandle = memoryManager.getOffsetHandle(first);
+		secondHandle = memoryManager.getOffsetHandle(second);
+		passed = passed && memoryManager.resolveOffsetHandle(firstHandle) == first && memoryManager.syncPersistentHeap() == 0;
+	}
+	{
+		MemoryManager memoryManager(8, BEST_FIT);
+		passed = passed && memoryManager.initializeFromFile(filename, 1) == 0 && memoryManager.getMemoryLimit() == 2000 * 8;
+		//the file's own size wins over the one asked for
+		void* first = memoryManager.resolveOffsetHandle(firstHandle);
+		void* second = memoryManager.resolveOffsetHandle(secondHandle);
+		passed = passed && checkBlock(first, 100, 1) && checkBlock(second, 300, 2);
+		passed = passed && memoryManager.getAllocationSize(first) == 104 && memoryManager.getAllocationSize(second) == 304;
+
+		uint64_t* holeList = static_cast<uint64_t*>(memoryManager.getWideList());
+		passed = passed && holeList[0] == 2 && holeList[1] == 13 && holeList[2] == 8;
+		std::free(holeList);
+		memoryManager.free(first);
+		memoryManager.free(second);
+	}
+	{
+		MemoryManager memoryManager(4, BEST_FIT);
+		passed = passed && memoryManager.initializeFromFile(filename, 2000) == -1;
+		//a different word size can't make sense of the blocks
+	}
+	{
+		MemoryManager memoryManager(8, BEST_FIT);
+		passed = passed && memoryManager.initializeFromFile(filename, 1) == 0 && memoryManager.isEmpty();
+		memoryManager.allocate(80);
+		memoryManager.allocate(80);
+	}
+	//closes with a table of two blocks, (0, 10) then (10, 10), straight after the arena
+
+	size_t tableOffset = sysconf(_SC_PAGESIZE) + 2000 * 8;
+	int file = open(filename, O_RDWR);
+	uint64_t badOffsets[] = {5, 1995, 10};
+	for (uint64_t badOffset : badOffsets) {
+		passed = passed && pwrite(file, &badOffset, sizeof(badOffset), tableOffset + 16) == sizeof(badOffset);
+		MemoryManager memoryManager(8, BEST_FIT);
+		passed = passed && memoryManager.initializeFromFile(filename, 1) == (badOffset == 10 ? 0 : -1);
+	}
+	//overlapping the first block, and running off the end of the arena. putting it back makes it a good heap again
+	passed = passed && ftruncate(file, tableOffset + 24) == 0;
+	{
+		MemoryManager memoryManager(8, BEST_FIT);
+		passed = passed && memoryManager.initializeFromFile(filename, 1) == -1;
+	}
+	passed = passed && ftruncate(file, tableOffset - 8) == 0;
+	{
+		MemoryManager memoryManager(8, BEST_FIT);
+		passed = passed && memoryManager.initializeFromFile(filename, 1) == -1;
+	}
+	//cut off partway through the table, then partway through the arena
+	close(file);
+	unlink(filename);
+	if (!passed) std::cout << "Failed: blocks or their contents didn't survive reopening" << std::endl;
+	return passed ? 1 : 0;
+}
+
+//std::pmr containers live in the arena, spill to the fallback once it's full, and give everything back when they're gone
+unsigned int testManagedMemoryResource(ArenaEngine engine) {
+	std::cout << "Test: pmr memory resource and allocator, " << engineName(engine) << " engine" << std::endl;
+	size_t arenaWords = 16384;
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.initialize(arenaWords, engine);
+	char* start = static_cast<char*>(memoryManager.getMemoryStart());
+	auto inArena = [&](const void* address) { return static_cast<const char*>(address) >= start && static_cast<const char*>(address) < start + arenaWords * 8; };
+
+	bool passed = true;
+	{
+		ManagedMemoryResource resource(memoryManager, std::pmr::new_delete_resource());
+		std::pmr::vector<int> values(&resource);
+		for (int i = 0; i < 1000; i++) values.push_back(i);
+		std::pmr::map<int, std::pmr::string> names(&resource);
+		for (int i = 0; i < 100; i++) names.emplace(i, std::pmr::string(30, static_cast<char>('a' + i % 26)));
+		std::map<int, long, std::less<int>, ManagedAllocator<std::pair<const int, long>>> squares{ManagedAllocator<std::pair<const int, long>>(resource)};
+		for (int i = 0; i < 100; i++) squares[i] = static_cast<long>(i) * i;
+		passed = inArena(values.data()) && inArena(names.at(7).data()) && resource.getUpstreamAllocations() == 0;
+
+		std::pmr::vector<char> tooBig(&resource);
+		tooBig.resize(arenaWords * 8);
+		passed = passed && !inArena(tooBig.data()) && resource.getUpstreamAllocations() == 1;
+		//doesn't fit, so it comes from new and delete instead
+
+		struct alignas(64) CacheLine { char bytes[64]; };
+		std::pmr::vector<CacheLine> lines(10, &resource);
+		passed = passed && reinterpret_cast<uintptr_t>(lines.data()) % 64 == 0;
+
+		for (int i = 0; i < 1000; i++) passed = passed && values[i] == i;
+		for (int i = 0; i < 100; i++) passed = passed && names[i].compare(std::string(30, static_cast<char>('a' + i % 26))) == 0 && squares[i] == static_cast<long>(i) * i;
+	}
+	passed = passed && memoryManager.isEmpty();
+
+	ManagedMemoryResource strict(memoryManager);
+	bool threw = false;
+	try {
+		void* block = strict.allocate(arenaWords * 8 * 2);
+		strict.deallocate(block, arenaWords * 8 * 2);
+	}
+	catch (std::bad_alloc&) {
+		threw = true;
+	}
+	passed = passed && threw;
+	if (!passed) std::cout << "Failed: containers weren't in the arena, or didn't fall back" << std::endl;
+	return passed ? 1 : 0;
+}
@@ -0,0 +1,127 @@
+#include "GrowableMemoryManager.h"
+
+GrowableMemoryManager::GrowableMemoryManager(unsigned wordSize, FitStrategy strategy, size_t arenaWords, ArenaEngine engine) {
+	bytesPerWord = wordSize;
+	fitStrategy = strategy;
+	arenaEngine = engine;
+	arenaSizeInWords = std::max(arenaWords, static_cast<size_t>(1));
+	maxArenas = 0;
+	lastArena = nullptr;
+	spareArena = nullptr;
+	arenasCreated = 0;
+	arenasReleased = 0;
+	failedAllocations = 0;
+}
+//no arenas until the first allocate, so an unused manager costs nothing
+
+void* GrowableMemoryManager::allocate(size_t sizeInBytes) {
+	if (lastArena != nullptr) {
+		void* block = lastArena->allocate(sizeInBytes);
+		if (block != nullptr) {
+			if (lastArena == spareArena) spareArena = nullptr;	//not empty any more
+			return block;
+		}
+	}
+	//most of the time the arena that worked last time still has room
+
+	for (auto iter = arenas.begin(); iter != arenas.end(); iter++) {
+		MemoryManager* arena = iter->second.get();
+		if (arena == lastArena) continue;
+		void* block = arena->allocate(sizeInBytes);
+		if (block != nullptr) {
+			lastArena = arena;
+			if (arena == spareArena) spareArena = nullptr;	//not empty any more
+			return block;
+		}
+	}
+	//each of these gives up right away if its biggest hole is too small, so a miss is cheap
+
+	MemoryManager* arena = addArena(std::max(arenaSizeInWords, MemoryManager::minimumArenaWords(sizeInBytes, bytesPerWord, arenaEngine)));
+	//an arena sized to the request exactly might not fit it: TLSF needs a header word on top, and a buddy arena's biggest block
+	//is the biggest power of two in it
+	void* block = arena == nullptr ? nullptr : arena->allocate(sizeInBytes);
+	if (block == nullptr) {
+		failedAllocations++;
+		return nullptr;
+	}
+	lastArena = arena;
+	return block;
+}
+
+void GrowableMemoryManager::free(void* address) {
+	MemoryManager* arena = findArena(address);
+	if (arena == nullptr) return;	//not in any of our arenas
+	arena->free(address);
+
+	if (arena->isEmpty()) {
+		if (spareArena == nullptr) spareArena = arena;
+		else if (spareArena != arena) releaseArena(arena);
+	}
+	//the first arena to empty out is kept as the spare, any more after that go back right away
+}
+
+void* GrowableMemoryManager::getAllocationStart(void* address) {
+	MemoryManager* arena = findArena(address);
+	return arena == nullptr ? nullptr : arena->getAllocationStart(address);
+}
+
+size_t GrowableMemoryManager::getAllocationSize(void* address) {
+	MemoryManager* arena = findArena(address);
+	return arena == nullptr ? 0 : arena->getAllocationSize(address);
+}
+
+void GrowableMemoryManager::setMaxArenas(size_t limit) {
+	maxArenas = limit;
+}
+//a cap on how far it can grow. 0 is no cap
+
+void GrowableMemoryManager::releaseEmptyArenas() {
+	std::vector<MemoryManager*> emptyArenas;
+	for (auto iter = arenas.begin(); iter != arenas.end(); iter++) {
+		if (iter->second->isEmpty()) emptyArenas.push_back(iter->second.get());
+	}
+	for (MemoryManager* arena : emptyArenas) releaseArena(arena);
+}
+//including the spare. collected first since releasing erases from the map we're walking
+
+ArenaChainStats GrowableMemoryManager::getStats() {
+	ArenaChainStats stats;
+	stats.arenas = arenas.size();
+	stats.capacityBytes = 0;
+	for (auto iter = arenas.begin(); iter != arenas.end(); iter++) stats.capacityBytes += iter->second->getMemoryLimit();
+	stats.arenasCreated = arenasCreated;
+	stats.arenasReleased = arenasReleased;
+	stats.failedAllocations = failedAllocations;
+	return stats;
+}
+
+MemoryManager* GrowableMemoryManager::findArena(void* address) {
+	char* addressForArithmetic = static_cast<char*>(address);
+	auto nextArena = arenas.upper_bound(addressForArithmetic);
+	if (nextArena == arenas.begin()) return nullptr;
+	MemoryManager* arena = std::prev(nextArena)->second.get();
+	if (addressForArithmetic >= static_cast<char*>(arena->getMemoryStart()) + arena->getMemoryLimit()) return nullptr;
+	return arena;
+}
+//the last arena starting at or before the address, if the address is inside it. same idea as the manager's own findBlock
+
+MemoryManager* GrowableMemoryManager::addArena(size_t sizeInWords) {
+	if (maxArenas != 0 && arenas.size() >= maxArenas) return nullptr;
+
+	std::unique_ptr<MemoryManager> arena(new MemoryManager(bytesPerWord, fitStrategy));
+	if (sizeInWords > SIZE_LIMIT) arena->setWideOffsets(true);	//only arenas that need it, so the small ones still work with getList and getBitmap
+	arena->initialize(sizeInWords, arenaEngine);
+	if (arena->getMemoryStart() == nullptr) return nullptr;		//too big, or the system's out of memory
+
+	MemoryManager* added = arena.get();
+	arenas[static_cast<char*>(added->getMemoryStart())] = std::move(arena);
+	arenasCreated++;
+	return added;
+}
+
+void GrowableMemoryManager::releaseArena(MemoryManager* arena) {
+	if (arena == lastArena) lastArena = nullptr;
+	if (arena == spareArena) spareArena = nullptr;
+	arenas.erase(static_cast<char*>(arena->getMemoryStart()));	//the unique_ptr deletes the manager, which frees its memory
+	arenasReleased++;
+}
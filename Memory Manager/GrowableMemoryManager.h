@@ -0,0 +1,44 @@
+#pragma once
+
+#include "MemoryManager.h"
+#include <memory>
+
+struct ArenaChainStats {
+	size_t arenas;
+	size_t capacityBytes;		//sum of every arena's size
+	size_t arenasCreated;
+	size_t arenasReleased;
+	size_t failedAllocations;	//only happens once maxArenas is reached (or the system is out of memory)
+};
+
+class GrowableMemoryManager {
+	private:
+		unsigned bytesPerWord;
+		FitStrategy fitStrategy;
+		ArenaEngine arenaEngine;
+		size_t arenaSizeInWords;
+		size_t maxArenas;		//0 for no limit
+		std::map<char*, std::unique_ptr<MemoryManager>> arenas;		//by start address, for sending frees to the right one
+		MemoryManager* lastArena;	//where the last allocation succeeded, tried first next time
+		MemoryManager* spareArena;	//one empty arena kept back, so a load hovering at an arena boundary doesn't create and release over and over
+		size_t arenasCreated;
+		size_t arenasReleased;
+		size_t failedAllocations;
+
+		MemoryManager* findArena(void* address);
+		MemoryManager* addArena(size_t sizeInWords);
+		void releaseArena(MemoryManager* arena);
+
+	public:
+		GrowableMemoryManager(unsigned wordSize, FitStrategy strategy, size_t arenaWords, ArenaEngine engine = HOLE_MAP_ENGINE);
+		void* allocate(size_t sizeInBytes);
+		void free(void* address);
+		void* getAllocationStart(void* address);
+		size_t getAllocationSize(void* address);
+		void setMaxArenas(size_t limit);
+		void releaseEmptyArenas();
+		ArenaChainStats getStats();
+};
+//a chain of MemoryManager arenas that grows when nothing fits instead of failing. each arena has its own holes and engine,
+//frees go to whichever arena holds the address, and arenas that empty out are given back
+//arenas are arenaWords long, or as long as the engine needs for a single request that's bigger than that
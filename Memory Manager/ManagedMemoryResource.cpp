@@ -0,0 +1,48 @@
+#include "ManagedMemoryResource.h"
+
+ManagedMemoryResource::ManagedMemoryResource(MemoryManager& manager, std::pmr::memory_resource* fallback) : memoryManager(manager) {
+	upstream = fallback;
+	upstreamAllocations.store(0);
+}
+
+void* ManagedMemoryResource::do_allocate(size_t bytes, size_t alignment) {
+	bytes = std::max(bytes, static_cast<size_t>(1));	//a 0 byte request still needs an address of its own
+	uintptr_t start = reinterpret_cast<uintptr_t>(memoryManager.getMemoryStart());
+	void* block;
+	if (start % alignment == 0 && memoryManager.getWordSize() % alignment == 0) block = memoryManager.allocate(bytes);
+	else block = memoryManager.allocate(bytes, alignment);
+	//every block starts on a word, so if the arena and the word size are both already lined up (like 8 byte words for most types),
+	//the normal allocate is aligned anyway and there's no need for the aligned search
+
+	if (block != nullptr) return block;
+	upstreamAllocations.fetch_add(1, std::memory_order_relaxed);
+	return upstream->allocate(bytes, alignment);
+	//the arena's full (or not initialized). the fallback either gives us memory or throws
+}
+
+void ManagedMemoryResource::do_deallocate(void* address, size_t bytes, size_t alignment) {
+	if (inArena(address)) memoryManager.free(address);
+	else upstream->deallocate(address, bytes, alignment);
+}
+//anything outside the arena must have come from the fallback
+
+bool ManagedMemoryResource::do_is_equal(const std::pmr::memory_resource& other) const noexcept {
+	const ManagedMemoryResource* otherResource = dynamic_cast<const ManagedMemoryResource*>(&other);
+	return otherResource != nullptr && &otherResource->memoryManager == &memoryManager && otherResource->upstream == upstream;
+}
+//two resources on the same manager (and fallback) can free each other's memory, so containers can swap and move between them
+
+MemoryManager& ManagedMemoryResource::getMemoryManager() const {
+	return memoryManager;
+}
+
+size_t ManagedMemoryResource::getUpstreamAllocations() {
+	return upstreamAllocations.load(std::memory_order_relaxed);
+}
+//how many requests didn't fit in the arena and went to the fallback instead
+
+bool ManagedMemoryResource::inArena(void* address) {
+	char* start = static_cast<char*>(memoryManager.getMemoryStart());
+	char* addressForArithmetic = static_cast<char*>(address);
+	return start != nullptr && addressForArithmetic >= start && addressForArithmetic < start + memoryManager.getMemoryLimit();
+}
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "MemoryManager.h"
+#include <memory_resource>
+#include <new>
+
+class ManagedMemoryResource : public std::pmr::memory_resource {
+	private:
+		MemoryManager& memoryManager;
+		std::pmr::memory_resource* upstream;
+		std::atomic<size_t> upstreamAllocations;	//atomic since a thread safe manager can have containers on several threads
+
+		bool inArena(void* address);
+
+	protected:
+		void* do_allocate(size_t bytes, size_t alignment) override;
+		void do_deallocate(void* address, size_t bytes, size_t alignment) override;
+		bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+
+	public:
+		ManagedMemoryResource(MemoryManager& manager, std::pmr::memory_resource* fallback = std::pmr::null_memory_resource());
+		MemoryManager& getMemoryManager() const;
+		size_t getUpstreamAllocations();
+};
+//lets std::pmr containers (vector, map, string, ...) keep their memory in a MemoryManager arena
+//memory_resource has to either return memory or throw, so when the arena is full the request goes to the fallback resource instead.
+//the default fallback is null_memory_resource, which throws std::bad_alloc. pass new_delete_resource to spill onto the regular heap
+//the manager has to outlive the resource and every container using it, and shouldn't be shutdown or reinitialized underneath them
+
+template <class T>
+class ManagedAllocator {
+	private:
+		ManagedMemoryResource* resource;
+		template <class U> friend class ManagedAllocator;
+
+	public:
+		typedef T value_type;
+
+		ManagedAllocator(ManagedMemoryResource& memoryResource) : resource(&memoryResource) {}
+		template <class U> ManagedAllocator(const ManagedAllocator<U>& other) : resource(other.resource) {}
+		//containers rebind to their node types, which needs a copy from an allocator of any other type
+
+		T* allocate(size_t count) {
+			if (count > SIZE_MAX / sizeof(T)) throw std::bad_array_new_length();
+			return static_cast<T*>(resource->allocate(count * sizeof(T), alignof(T)));
+		}
+		void deallocate(T* address, size_t count) {
+			resource->deallocate(address, count * sizeof(T), alignof(T));
+		}
+
+		template <class U> bool operator==(const ManagedAllocator<U>& other) const { return resource == other.resource; }
+		template <class U> bool operator!=(const ManagedAllocator<U>& other) const { return resource != other.resource; }
+};
+//the same thing as a classic allocator, for code that takes an allocator template argument instead of std::pmr types
+//it goes through the resource, so it gets the same fallback when the arena is full
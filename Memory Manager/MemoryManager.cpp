@@ -1,37 +1,285 @@
 #include "MemoryManager.h"
+#include <ext/pb_ds/assoc_container.hpp>
+#include <ext/pb_ds/tree_policy.hpp>
+#include <sys/mman.h>
+//mmap for arenas that don't come from malloc
+
+struct ThreadCache {
+	uint64_t managerId;
+	uint64_t arenaGeneration;
+	std::vector<void*> blocks[THREAD_CACHE_MAX_WORDS + 1];	//blocks[n] holds free n word blocks, most recently freed last
+};
+
+struct ThreadCacheSet {
+	std::vector<ThreadCache*> caches;
+	~ThreadCacheSet();
+};
+//every thread gets one of these, with a cache for each thread safe manager it's used
+
+static thread_local ThreadCacheSet threadCaches;
+static std::mutex managerRegistryLock;
+static std::map<uint64_t, MemoryManager*> liveManagers;
+static std::atomic<uint64_t> nextManagerId(1);
+//so a thread that's exiting can find out whether the manager its cache came from still exists before handing blocks back
+
+//node update for GCC's policy based tree, so the first fit index knows the longest hole under every node in it
+//that's all it takes to find the lowest offset hole that fits in one trip down the tree, instead of a walk through all the holes
+template <class NodeConstIterator, class NodeIterator, class Compare, class Allocator>
+struct LargestHoleUpdate {
+	typedef size_t metadata_type;
+
+	void operator()(NodeIterator node, NodeConstIterator endNode) {
+		size_t largest = (*node)->second;
+		NodeIterator left = node.get_l_child();
+		NodeIterator right = node.get_r_child();
+		if (left != endNode) largest = std::max(largest, left.get_metadata());
+		if (right != endNode) largest = std::max(largest, right.get_metadata());
+		const_cast<size_t&>(node.get_metadata()) = largest;
+	}
+	//the tree calls this on a node whenever anything under it changes, children first
+
+	int64_t firstFit(size_t sizeInWords, size_t fromOffset = 0) const {
+		return firstFitUnder(node_begin(), sizeInWords, fromOffset);
+	}
+	//the lowest offset hole at or after fromOffset that's at least sizeInWords long, or -1
+
+	int64_t firstFitUnder(NodeConstIterator node, size_t sizeInWords, size_t fromOffset) const {
+		if (node == node_end() || node.get_metadata() < sizeInWords) return -1;
+		if ((*node)->first < fromOffset) return firstFitUnder(node.get_r_child(), sizeInWords, fromOffset);
+		int64_t left = firstFitUnder(node.get_l_child(), sizeInWords, fromOffset);
+		if (left >= 0) return left;
+		if ((*node)->second >= sizeInWords) return (*node)->first;
+		return firstFitUnder(node.get_r_child(), sizeInWords, fromOffset);
+	}
+	//lower offsets are to the left, so try there first. a subtree whose longest hole is too short is skipped without going in,
+	//so past the path down to fromOffset, only one subtree ever gets searched all the way down
+
+	virtual NodeConstIterator node_begin() const = 0;
+	virtual NodeConstIterator node_end() const = 0;
+	virtual ~LargestHoleUpdate() {}
+};
+struct FirstFitIndex : __gnu_pbds::tree<size_t, size_t, std::less<size_t>, __gnu_pbds::rb_tree_tag, LargestHoleUpdate> {};
+//offset to length, like holes. std::map has nowhere to keep a per node value, and the policy based tree is built for exactly that
+
+HoleView::HoleView(const std::map<size_t, size_t>& holeMap) : holes(holeMap) {}
+
+HoleView::iterator HoleView::begin() const {
+	return holes.begin();
+}
+
+HoleView::iterator HoleView::end() const {
+	return holes.end();
+}
+
+size_t HoleView::size() const {
+	return holes.size();
+}
 
 MemoryManager::MemoryManager(unsigned wordSize, std::function<int(int, void*)> allocator) {
 	memoryStart = nullptr;
 	isInitialized = false;
 	bytesPerWord = wordSize;
 	memorySizeInWords = 0;
+	arenaLimitInWords = SIZE_LIMIT;
+	mmapBacking = false;
+	hugePageBacking = false;
+	arenaMapped = false;
+	mappedBytes = 0;
+	pageReleaseBytes = 0;
+	reallocationStats = ReallocationStats();
+	freeWordCount = 0;
+	freeBlockCount = 0;
+	memset(freeBlockHistogram, 0, sizeof(freeBlockHistogram));
+	allocationCount = 0;
+	freeCount = 0;
+	failedAllocationCount = 0;
+	compactionCursor = 0;
+	traceFile = nullptr;
+	nextTraceId = 1;
+	heapFile = -1;
+	heapFileDirty = false;
+	heapHeaderBytes = 0;
 	allocatorFunction = allocator;
+	liveBitmapEnabled = false;
+	arenaEngine = HOLE_MAP_ENGINE;
+	buddyNonEmptyOrders = 0;
+	tlsfFirstLevel = 0;
+	tlsfLargest = 0;
+	tlsfLargestKnown = true;
+	tlsfInBlock = false;
+	threadSafe = false;
+	arenaGeneration = 0;
+	managerId = nextManagerId++;
+	remoteFrees.store(nullptr);
+	std::lock_guard<std::mutex> registryLock(managerRegistryLock);
+	liveManagers[managerId] = this;
+	chooseStrategy(allocatorFunction);
+}
+
+MemoryManager::MemoryManager(unsigned wordSize, FitStrategy strategy) {
+	memoryStart = nullptr;
+	isInitialized = false;
+	bytesPerWord = wordSize;
+	memorySizeInWords = 0;
+	arenaLimitInWords = SIZE_LIMIT;
+	mmapBacking = false;
+	hugePageBacking = false;
+	arenaMapped = false;
+	mappedBytes = 0;
+	pageReleaseBytes = 0;
+	reallocationStats = ReallocationStats();
+	freeWordCount = 0;
+	freeBlockCount = 0;
+	memset(freeBlockHistogram, 0, sizeof(freeBlockHistogram));
+	allocationCount = 0;
+	freeCount = 0;
+	failedAllocationCount = 0;
+	compactionCursor = 0;
+	traceFile = nullptr;
+	nextTraceId = 1;
+	heapFile = -1;
+	heapFileDirty = false;
+	heapHeaderBytes = 0;
+	allocatorFunction = nullptr;
+	liveBitmapEnabled = (strategy == BITMAP_FIRST_FIT);
+	arenaEngine = HOLE_MAP_ENGINE;
+	buddyNonEmptyOrders = 0;
+	tlsfFirstLevel = 0;
+	tlsfLargest = 0;
+	tlsfLargestKnown = true;
+	tlsfInBlock = false;
+	threadSafe = false;
+	arenaGeneration = 0;
+	if (strategy == FIRST_FIT) firstFitHoles.reset(new FirstFitIndex());		//no holes yet, so nothing to build
+	managerId = nextManagerId++;
+	remoteFrees.store(nullptr);
+	std::lock_guard<std::mutex> registryLock(managerRegistryLock);
+	liveManagers[managerId] = this;
+	fitStrategy = strategy;
 }
 
 MemoryManager::~MemoryManager() {
+	{
+		std::lock_guard<std::mutex> registryLock(managerRegistryLock);
+		liveManagers.erase(managerId);
+	}
+	//after this no exiting thread will try to flush into us
+	stopTrace();
 	shutdown();		//free any memory related to whatever block is open when the manager terminates
 }
 
-void MemoryManager::initialize(size_t sizeInWords) {
-	if (sizeInWords > SIZE_LIMIT) return;	//if the requested block is larger than possible, don't make it
+void MemoryManager::initialize(size_t sizeInWords, ArenaEngine engine) {
+	if (sizeInWords > arenaLimitInWords) return;	//if the requested block is larger than possible, don't make it
 
-	shutdown();	
+	auto lock = lockCentral();
+	shutdownUnlocked();
 	//clear the already initialized memory, if there is any
 	//the if is handled by shutdown, so just call it and let it do its thing
+	//held the whole way, so a thread exiting partway through sees the old arena or the new one, never half of each
 
 	memorySizeInWords = sizeInWords;
-	memoryStart = malloc(sizeInWords * bytesPerWord);	//since we want a void pointer, no cast on malloc
+	if (mmapBacking) {
+		size_t pageSize = sysconf(_SC_PAGESIZE);
+		size_t alignment = hugePageBacking ? HUGE_PAGE_BYTES : pageSize;
+		size_t arenaBytes = std::max(sizeInWords * bytesPerWord, static_cast<size_t>(1));
+		arenaBytes = (arenaBytes + pageSize - 1) / pageSize * pageSize;
+		size_t reservedBytes = arenaBytes + alignment - pageSize;
+		char* reserved = static_cast<char*>(mmap(nullptr, reservedBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0));
+		//anonymous pages don't exist until they're touched, and MAP_NORESERVE skips reserving swap for them,
+		//so a huge arena only costs what actually gets used
+
+		if (reserved != MAP_FAILED) {
+			char* aligned = reinterpret_cast<char*>((reinterpret_cast<uintptr_t>(reserved) + alignment - 1) / alignment * alignment);
+			if (aligned != reserved) munmap(reserved, aligned - reserved);
+			if (aligned + arenaBytes != reserved + reservedBytes) munmap(aligned + arenaBytes, reserved + reservedBytes - (aligned + arenaBytes));
+			//mmap only promises page alignment. huge pages need the start on a 2MB boundary, so map a bit extra and trim both ends
+#ifdef MADV_HUGEPAGE
+			if (hugePageBacking) madvise(aligned, arenaBytes, MADV_HUGEPAGE);
+#endif
+			//just a hint, the kernel decides if it actually uses them
+			memoryStart = aligned;
+			mappedBytes = arenaBytes;
+			arenaMapped = true;
+		}
+		else memoryStart = nullptr;
+	}
+	else memoryStart = malloc(sizeInWords * bytesPerWord);	//since we want a void pointer, no cast on malloc
+	if (memoryStart == nullptr) {
+		memorySizeInWords = 0;
+		return;
+	}
+	//with wide offsets someone can actually ask for more than the system has, so stay uninitialized if malloc says no
 	isInitialized = true;
-	holes[0] = sizeInWords;
+	arenaGeneration++;
+	if (threadSafe) cacheClassTags.assign(sizeInWords, 0);
+	arenaEngine = engine;
+	if (arenaEngine == BUDDY_ENGINE) buddySetup();
+	else if (arenaEngine == TLSF_ENGINE) {
+		if (!tlsfSetup()) {
+			shutdownUnlocked();
+			return;
+		}
+		//no room for TLSF's tables means no arena, the same as when malloc says no to the arena itself
+	}
+	else addHole(0, sizeInWords);
+	if (liveBitmapEnabled) rebuildLiveBitmap();
 	//initialize variables related to the curernt block, not the whole manager
-	//at the start we have 1 hole the size of the whole manager
+	//at the start we have 1 hole the size of the whole manager (or for buddy, as few power of two blocks as add up to it)
 }
 
 void MemoryManager::shutdown() {
+	auto lock = lockCentral();
+	shutdownUnlocked();
+}
+//in thread safe mode other threads can exit (and flush their caches) while this runs, but none of them can still be allocating or
+//freeing: a block from the arena that's going away has nowhere valid to go
+
+void MemoryManager::shutdownUnlocked() {
+	drainRemoteFrees();		//nodes from the heap need deleting, and the blocks are about to be gone anyway
+	if (heapFile != -1) {
+		syncPersistentHeapUnlocked();
+		close(heapFile);
+		heapFile = -1;
+	}
+	//a persistent heap writes its blocks out first, so the next process can pick up where we left off
 	if(isInitialized){
-		std::free(memoryStart);
+		if (arenaMapped) munmap(memoryStart, mappedBytes);
+		else std::free(memoryStart);
+		arenaMapped = false;
+		mappedBytes = 0;
 		allocatedMemory.clear();
 		holes.clear();
+		holesBySize.clear();
+		if (firstFitHoles) firstFitHoles->clear();
+		freeWordCount = 0;
+		freeBlockCount = 0;
+		memset(freeBlockHistogram, 0, sizeof(freeBlockHistogram));
+		handleSlots.clear();
+		freeHandleSlots.clear();
+		handleBlocks.clear();
+		compactionCursor = 0;
+		alignedBlocks.clear();
+		liveBitmap.clear();
+		reportedHoles.clear();
+		buddyFreeLists.clear();
+		buddyFreeBits.clear();
+		buddyNonEmptyOrders = 0;
+		tlsfTags.clear();
+		tlsfTags.shrink_to_fit();
+		tlsfNext.clear();
+		tlsfNext.shrink_to_fit();
+		tlsfPrev.clear();
+		tlsfPrev.shrink_to_fit();
+		tlsfStarts.clear();
+		tlsfStarts.shrink_to_fit();
+		tlsfHeads.clear();
+		tlsfFirstLevel = 0;
+		tlsfLargest = 0;
+		tlsfLargestKnown = true;
+		tlsfInBlock = false;
+		cacheClassTags.clear();
+		arenaGeneration++;		//whatever the thread caches are holding was in the arena we just freed
+		//the TLSF tables are as big as the arena, so actually give them back
 		//we wipe the data structure of allocated memory, since that memory's all gone now
 
 		memoryStart = nullptr;
@@ -43,6 +291,52 @@ void MemoryManager::shutdown() {
 }
 
 void* MemoryManager::allocate(size_t sizeInBytes) {
+	void* block = allocateBlock(sizeInBytes);
+	if (traceFile != nullptr) traceAllocate(block, sizeInBytes, 0);
+	return block;
+}
+
+void* MemoryManager::allocateBlock(size_t sizeInBytes) {
+	if (!threadSafe) {
+		if (remoteFrees.load(std::memory_order_relaxed) != nullptr) drainRemoteFrees();
+		void* block = allocateUnlocked(sizeInBytes);
+		if (block == nullptr) failedAllocationCount++;
+		return block;
+	}
+	//single owner: frees other threads sent with freeRemote get done here, all at once
+
+	size_t sizeInWords = sizeInBytes / bytesPerWord + (sizeInBytes % bytesPerWord != 0 ? 1 : 0);
+	if (sizeInWords == 0 || sizeInWords > THREAD_CACHE_MAX_WORDS) {
+		auto lock = lockCentral();
+		void* block = allocateUnlocked(sizeInBytes);
+		if (block == nullptr) failedAllocationCount++;
+		return block;
+	}
+	//too big to cache, so it's a normal allocation, just under the lock
+
+	ThreadCache* cache = threadCache();
+	std::vector<void*>& blocks = cache->blocks[sizeInWords];
+	if (blocks.empty()) {
+		auto lock = lockCentral();
+		for (int i = 0; i < THREAD_CACHE_BATCH; i++) {
+			void* block = allocateUnlocked(sizeInWords * bytesPerWord);
+			if (block == nullptr) break;
+			cacheClassTags[wordOffsetOf(block)] = static_cast<uint8_t>(sizeInWords);
+			blocks.push_back(block);
+		}
+		if (blocks.empty()) {
+			failedAllocationCount++;
+			return nullptr;
+		}
+	}
+	//out of this size, so take a whole batch while we have the lock. the next THREAD_CACHE_BATCH - 1 don't need it at all
+
+	void* block = blocks.back();
+	blocks.pop_back();
+	return block;
+}
+
+void* MemoryManager::allocateUnlocked(size_t sizeInBytes) {
 	if (sizeInBytes > (memorySizeInWords * bytesPerWord)) return nullptr;
 	//invalid size: more than block can hold
 	
@@ -50,34 +344,215 @@ void* MemoryManager::allocate(size_t sizeInBytes) {
 	if(totalBytes % bytesPerWord != 0) totalBytes += (bytesPerWord - sizeInBytes % bytesPerWord); 
 	//corrects number of bytes, as it needs to allocate a flat number of words. Pads bytes to fill a possible temporary word
 
-	int newMemoryLength = totalBytes / bytesPerWord; //convert from bytes to words
-	void* holeList = getList();
+	size_t newMemoryLength = totalBytes / bytesPerWord; //convert from bytes to words
+	int64_t newOffset = -1;
+
+	if (arenaEngine == BUDDY_ENGINE) {
+		newOffset = buddyAllocate(newMemoryLength);	//also rounds newMemoryLength up to the block it actually got
+		if (newOffset < 0) return nullptr;
+		allocatedMemory[newOffset] = newMemoryLength;
+		if (liveBitmapEnabled) markLiveBits(newOffset, newOffset + newMemoryLength, true);
+		allocationCount++;
+		return addressOf(newOffset);
+	}
+	//the buddy engine has its own free lists, so none of the hole map work below applies
+
+	if (arenaEngine == TLSF_ENGINE) {
+		newOffset = tlsfAllocate(newMemoryLength);	//also sets newMemoryLength to the whole block, header and all
+		if (newOffset < 0) return nullptr;
+		if (liveBitmapEnabled) markLiveBits(newOffset, newOffset + newMemoryLength, true);
+		allocationCount++;
+		return addressOf(newOffset + tlsfHeaderWords());
+	}
+	//TLSF doesn't use allocatedMemory either. the block's boundary tags are all it needs to free it later
+
+	if (fitStrategy == CUSTOM_FIT) {
+		void* holeList = buildList();
+		if (holeList == nullptr) return nullptr;	//arena's too big for the 16 bit list, so this allocator can't be used on it
 
-	int newOffset = allocatorFunction(newMemoryLength, holeList);
-	std::free(holeList);		//deallocate hole list now that we've used it
-	//make sure to specify std or it's gonna use its own free oops
+		newOffset = allocatorFunction(static_cast<int>(newMemoryLength), holeList);
+		std::free(holeList);		//deallocate hole list now that we've used it
+		//make sure to specify std or it's gonna use its own free oops
+	}
+	else if (fitStrategy == CUSTOM_WIDE_FIT) {
+		void* holeList = buildWideList();
+		newOffset = wideAllocatorFunction(newMemoryLength, holeList);
+		std::free(holeList);
+	}
+	else if (fitStrategy == CUSTOM_VIEW_FIT) newOffset = viewAllocatorFunction(newMemoryLength, HoleView(holes));
+	else newOffset = findHole(newMemoryLength);
+	//view allocators and the built in strategies skip making the list entirely
 
-	if (newOffset == -1) return nullptr;	//allocator couldn't find a valid hole, so exit
+	if (newOffset < 0) return nullptr;	//allocator couldn't find a valid hole, so exit
+
+	auto chosenHole = holes.find(newOffset);
+	if (chosenHole == holes.end() || chosenHole->second < newMemoryLength) return nullptr;
+	//a custom allocator could hand back something that isn't a hole, or one that's too small. treat it like a failure
 
 	allocatedMemory[newOffset] = newMemoryLength;
+	if (heapFile != -1) markHeapDirty();
 	//allocating can only add one new block of allocated memory, so just put it in
 	//don't have to worry about a conflict, since that's not possible
+	if (liveBitmapEnabled) markLiveBits(newOffset, newOffset + newMemoryLength, true);
 
-	if (newMemoryLength == holes[newOffset]) {	//new offset is the beginning of an old hole, so it's a valid key for holes
-		holes.erase(newOffset);
+	if (newMemoryLength == chosenHole->second) {	//new offset is the beginning of an old hole, so it's a valid key for holes
+		removeHole(chosenHole);
 	}
 	//first case: hole filled was exactly the size of the memory
 	//just delete the hole, since it was filled entirely then there's no hole
 
 	else {
-		int newHoleSize = holes[newOffset] - newMemoryLength;	//the size of the new hole is the old size minus the space taken for memory
-		int newHoleOffset = newOffset + newMemoryLength;		//the start of the new hole is the start of the old hole plus the offset for new memory
-		holes.erase(newOffset);		//remove the old hole
-		holes[newHoleOffset] = newHoleSize;		//add the new hole
+		size_t newHoleSize = chosenHole->second - newMemoryLength;	//the size of the new hole is the old size minus the space taken for memory
+		size_t newHoleOffset = newOffset + newMemoryLength;		//the start of the new hole is the start of the old hole plus the offset for new memory
+		removeHole(chosenHole);		//remove the old hole
+		addHole(newHoleOffset, newHoleSize);		//add the new hole
 	}
 	//second case: hole was partially filled
 
-	int bytesFromBeginning = newOffset * bytesPerWord;	//convert the new offset from words to bytes to get address
+	allocationCount++;
+	return addressOf(newOffset);
+}
+
+//allocate with the returned address a multiple of alignment (a power of two), for SIMD loads or keeping things on their own cache line
+//on the hole map, the block starts partway into a hole and the words skipped to get there stay a hole, so nothing is wasted
+//the other engines can't place a block partway into their free blocks, so they allocate alignment - 1 bytes extra and hand back
+//the aligned address inside it. free takes that address, getAllocationSize counts from it, and getAllocationStart gives the real start
+void* MemoryManager::allocate(size_t sizeInBytes, size_t alignment) {
+	void* block = allocateAlignedBlock(sizeInBytes, alignment);
+	if (traceFile != nullptr) traceAllocate(block, sizeInBytes, alignment);
+	return block;
+}
+
+void* MemoryManager::allocateAlignedBlock(size_t sizeInBytes, size_t alignment) {
+	if (alignment == 0 || (alignment & (alignment - 1)) != 0) return nullptr;	//not a power of two
+	auto lock = lockCentral();
+	//always the central path, even in thread safe mode. the thread caches don't know anything about alignment
+	if (!isInitialized) return nullptr;
+	void* block = allocateAlignedUnlocked(sizeInBytes, alignment);
+	if (block == nullptr) failedAllocationCount++;
+	return block;
+}
+
+void* MemoryManager::allocateAlignedUnlocked(size_t sizeInBytes, size_t alignment) {
+	if (sizeInBytes > memorySizeInWords * bytesPerWord || sizeInBytes > SIZE_MAX - alignment) return nullptr;
+	//too big for the arena. the padding and rounding below would wrap round to a small size for these, not fail
+
+	uintptr_t base = reinterpret_cast<uintptr_t>(memoryStart);
+	bool alignedAnyway = base % alignment == 0 && bytesPerWord % alignment == 0;
+	//every block starts on a word, so with the arena and the word size both lined up, any block would do
+
+	if (arenaEngine != HOLE_MAP_ENGINE) {
+		char* block = static_cast<char*>(allocateUnlocked(sizeInBytes + alignment - 1));
+		if (block == nullptr) return nullptr;
+		if (!alignedAnyway) alignedBlocks[wordOffsetOf(block)] = alignment;
+		uintptr_t address = reinterpret_cast<uintptr_t>(block);
+		return block + ((address + alignment - 1) / alignment * alignment - address);
+	}
+
+	size_t sizeInWords = std::max((sizeInBytes + bytesPerWord - 1) / bytesPerWord, static_cast<size_t>(1));
+	size_t holeOffset;
+	int64_t newOffset = findAlignedHole(sizeInWords, alignment, holeOffset);
+	if (newOffset < 0) return nullptr;
+
+	auto chosenHole = holes.find(holeOffset);
+	size_t holeEnd = chosenHole->first + chosenHole->second;
+	removeHole(chosenHole);
+	if (static_cast<size_t>(newOffset) > holeOffset) addHole(holeOffset, newOffset - holeOffset);
+	if (newOffset + sizeInWords < holeEnd) addHole(newOffset + sizeInWords, holeEnd - (newOffset + sizeInWords));
+	//up to three pieces: the padding before (still a hole), the block, and whatever's left after (also still a hole)
+	//neither new hole touches another one, since the old hole didn't, so there's nothing to merge
+
+	allocatedMemory[newOffset] = sizeInWords;
+	if (heapFile != -1) markHeapDirty();
+	if (liveBitmapEnabled) markLiveBits(newOffset, newOffset + sizeInWords, true);
+	if (!alignedAnyway) alignedBlocks[newOffset] = alignment;
+	allocationCount++;
+	return addressOf(newOffset);
+}
+
+//first word at or after offset whose address is a multiple of alignment, or -1 if none ever will be
+//the aligned addresses are alignment apart, and whether one lands on a word boundary repeats every bytesPerWord of them at most,
+//so if none of the first bytesPerWord do, none ever will (like asking for 8 byte alignment with 4 byte words on a base that's off by 2)
+int64_t MemoryManager::alignedOffset(size_t offset, size_t alignment) {
+	uintptr_t base = reinterpret_cast<uintptr_t>(memoryStart);
+	uintptr_t aligned = (base + offset * bytesPerWord + alignment - 1) / alignment * alignment;
+	for (unsigned tries = 0; tries < bytesPerWord; tries++) {
+		if ((aligned - base) % bytesPerWord == 0) return (aligned - base) / bytesPerWord;
+		aligned += alignment;
+	}
+	return -1;
+}
+
+//the aligned offset for a block of sizeInWords, with holeOffset set to the hole it's in. -1 if no hole can fit it
+//holes are tried in the order the fit strategy would pick them: smallest first for best fit, biggest first for worst fit,
+//and lowest offset first for first fit and the custom allocators (which don't know about alignment)
+int64_t MemoryManager::findAlignedHole(size_t sizeInWords, size_t alignment, size_t& holeOffset) {
+	if (alignedOffset(0, alignment) < 0) return -1;
+	size_t wordsBetweenAligned = alignment / std::min(alignment, static_cast<size_t>(bytesPerWord & -bytesPerWord));
+	//alignment is a power of two, so what it shares with the word size is just the word size's lowest set bit
+	size_t certainFit = sizeInWords + wordsBetweenAligned - 1;
+	//the padding never needs to be more than wordsBetweenAligned - 1 words, so a hole at least certainFit long always works
+
+	if (fitStrategy == BEST_FIT) {
+		auto iter = holesBySize.lower_bound(std::make_pair(sizeInWords, static_cast<size_t>(0)));
+		for (int checked = 0; iter != holesBySize.end() && iter->first < certainFit && checked < ALIGNED_FIT_SCAN_LIMIT; iter++, checked++) {
+			int64_t start = alignedOffset(iter->second, alignment);
+			if (start + sizeInWords <= iter->second + iter->first) {
+				holeOffset = iter->second;
+				return start;
+			}
+		}
+		//holes between sizeInWords and certainFit only work if they happen to start in the right place. a heap full of
+		//them that don't would make this a linear scan, so after a few misses go straight to the smallest one that's certain
+
+		iter = holesBySize.lower_bound(std::make_pair(certainFit, static_cast<size_t>(0)));
+		if (iter == holesBySize.end()) return -1;
+		holeOffset = iter->second;
+		return alignedOffset(iter->second, alignment);
+	}
+
+	if (fitStrategy == WORST_FIT) {
+		for (auto iter = holesBySize.rbegin(); iter != holesBySize.rend() && iter->first >= sizeInWords; iter++) {
+			int64_t start = alignedOffset(iter->second, alignment);
+			if (start + sizeInWords <= iter->second + iter->first) {
+				holeOffset = iter->second;
+				return start;
+			}
+		}
+		return -1;
+	}
+
+	if (fitStrategy == FIRST_FIT) {
+		int64_t certainOffset = firstFitHoles->firstFit(certainFit);
+		int64_t candidate = firstFitHoles->firstFit(sizeInWords);
+		for (int checked = 0; candidate >= 0 && candidate != certainOffset && checked < ALIGNED_FIT_SCAN_LIMIT; checked++) {
+			size_t holeLength = holes.find(candidate)->second;
+			int64_t start = alignedOffset(candidate, alignment);
+			if (start + sizeInWords <= candidate + holeLength) {
+				holeOffset = candidate;
+				return start;
+			}
+			candidate = firstFitHoles->firstFit(sizeInWords, candidate + 1);
+		}
+		if (certainOffset < 0) return -1;
+		holeOffset = certainOffset;
+		return alignedOffset(certainOffset, alignment);
+	}
+	//same idea as best fit, in offset order: the holes that might fit get a few tries, then the lowest one that's certain to
+
+	for (auto iter = holes.begin(); iter != holes.end(); iter++) {
+		if (iter->second < sizeInWords) continue;
+		int64_t start = alignedOffset(iter->first, alignment);
+		if (start + sizeInWords <= iter->first + iter->second) {
+			holeOffset = iter->first;
+			return start;
+		}
+	}
+	return -1;
+}
+
+void* MemoryManager::addressOf(size_t wordOffset) {
+	size_t bytesFromBeginning = wordOffset * bytesPerWord;	//convert the offset from words to bytes to get address
 	char* pointerForArithmetic = static_cast<char*>(memoryStart);
 	char* returnPointer = pointerForArithmetic + bytesFromBeginning;
 	//we can't do pointer arithmetic on a void pointer, so we convert it to a char* to do arithmetic
@@ -86,48 +561,161 @@ void* MemoryManager::allocate(size_t sizeInBytes) {
 	return static_cast<void*>(returnPointer);
 }
 
-void MemoryManager::free(void* address) {
+//the other way around from addressOf: which word an address is in, or -1 if it's not in the arena
+int64_t MemoryManager::wordOffsetOf(void* address) {
+	if (!isInitialized) return -1;
+
 	char* pointerForArithmetic = static_cast<char*>(memoryStart);
-	int addressByteOffset = static_cast<char*>(address) - pointerForArithmetic;
+	char* addressForArithmetic = static_cast<char*>(address);
+	if (addressForArithmetic < pointerForArithmetic || addressForArithmetic >= pointerForArithmetic + memorySizeInWords * bytesPerWord) {
+		return -1;
+	}
+	//not in our arena at all
+
+	size_t addressByteOffset = addressForArithmetic - pointerForArithmetic;
 	//like with allocate, convert to char* for arithmetic
 
-	int addressWordOffset = addressByteOffset / bytesPerWord;
+	return addressByteOffset / bytesPerWord;
 	//this is division with an integer, so we're losing a decimal
 	//this is intentional: if it comes back as being, say, in word offset 4.5, that means it's contained within the word that starts at 4
 	//so dropping the decimal will get us the beginning of the word we need
+}
 
-	int memoryBegin = 0;
-	int memoryEnd = 0;
-	//declare these outside the for loop so we can refer back to them later
+std::map<size_t, size_t>::iterator MemoryManager::findBlock(void* address) {
+	int64_t wordOffset = wordOffsetOf(address);
+	if (wordOffset < 0) return allocatedMemory.end();
+	size_t addressWordOffset = wordOffset;
 
-	for (auto iter = allocatedMemory.begin(); iter != allocatedMemory.end(); iter++) {
-		memoryBegin = iter->first;
-		memoryEnd = memoryBegin + iter->second;		//memoryEnd is the first byte not allocated
-		//find out where the current tracked memory begins and ends
+	auto exactBlock = allocatedMemory.find(addressWordOffset);
+	if (exactBlock != allocatedMemory.end() && exactBlock->second > 0) return exactBlock;
+	//fast path: almost every free gets the same pointer allocate handed out, which is the exact start of a block
 
-		if ((addressWordOffset >= memoryBegin) && (addressWordOffset < memoryEnd)) {	//bounded by begin and end means we're in this chunk
-			allocatedMemory.erase(iter);
-			break;
-		}
-		//for allocated memory, all we need to do is delete the tracker for the piece of memory we just freed
+	auto nextBlock = allocatedMemory.upper_bound(addressWordOffset);
+	if (nextBlock == allocatedMemory.begin()) return allocatedMemory.end();
+	auto block = std::prev(nextBlock);
+	//allocatedMemory is sorted by offset, so the only block that could hold the address is the last one starting at or before it
+	//that's one search down the tree instead of walking every block from the beginning
+
+	if (addressWordOffset < block->first + block->second) return block;
+	return allocatedMemory.end();
+	//the address could still be past the end of that block, in a hole
+}
+
+void* MemoryManager::getAllocationStart(void* address) {
+	auto lock = lockCentral();
+	if (arenaEngine == TLSF_ENGINE) {
+		int64_t blockOffset = tlsfFindBlock(address);
+		return blockOffset < 0 ? nullptr : addressOf(blockOffset + tlsfHeaderWords());
+	}
+	auto block = findBlock(address);
+	if (block == allocatedMemory.end()) return nullptr;
+	return static_cast<void*>(static_cast<char*>(memoryStart) + block->first * bytesPerWord);
+}
+//for any pointer into an allocation, give back the pointer allocate returned for it
+
+size_t MemoryManager::getAllocationSize(void* address) {
+	auto lock = lockCentral();
+	size_t blockEnd;
+	if (arenaEngine == TLSF_ENGINE) {
+		int64_t blockOffset = tlsfFindBlock(address);
+		if (blockOffset < 0) return 0;
+		blockEnd = blockOffset + (tlsfTag(blockOffset) >> TLSF_TAG_BITS);
+	}
+	else {
+		auto block = findBlock(address);
+		if (block == allocatedMemory.end()) return 0;
+		blockEnd = block->first + block->second;
+	}
+	return blockEnd * bytesPerWord - (static_cast<char*>(address) - static_cast<char*>(memoryStart));
+}
+//how many bytes can be used starting at address: from there to the end of the allocation it points into, 0 if it isn't allocated
+//for the pointer allocate returned that's the whole block, rounded up to whole words like allocate does. for an aligned block
+//on buddy or TLSF it leaves out the padding in front of the pointer
+
+void MemoryManager::free(void* address) {
+	if (traceFile != nullptr) traceFree(address, true);
+	//before the free, while the address is still ours. afterwards another thread could already have been handed it
+	if (!threadSafe) {
+		freeUnlocked(address);
+		return;
 	}
 
-	int sizeOfNewHole = memoryEnd - memoryBegin;
-	holes[memoryBegin] = sizeOfNewHole;
-	//memorybegin and end are still set to the start and end of the block we just removed
-	//since we just removed it, there's a hole where the old memory was
+	int64_t wordOffset = wordOffsetOf(address);
+	if (wordOffset >= 0 && cacheClassTags[wordOffset] != 0) {
+		size_t sizeInWords = cacheClassTags[wordOffset];
+		ThreadCache* cache = threadCache();
+		cache->blocks[sizeInWords].push_back(addressOf(wordOffset));
+		if (cache->blocks[sizeInWords].size() > THREAD_CACHE_LIMIT) flushCache(cache, sizeInWords, THREAD_CACHE_LIMIT / 2);
+		return;
+	}
+	//a cache block goes into this thread's cache, whichever thread it came from. it stays allocated as far as the arena knows
+	//only the exact pointer (or one in its first word) is recognized, anything else takes the locked path below, which also works
+
+	std::unique_lock<std::mutex> lock(centralLock, std::try_to_lock);
+	if (!lock.owns_lock()) {
+		pushRemoteFree(address);
+		return;
+	}
+	drainRemoteFrees();
+	freeUnlocked(address);
+	//if someone else has the lock, leave it for them instead of waiting. whoever takes the lock next does it
+}
+
+void MemoryManager::freeUnlocked(void* address) {
+	if (arenaEngine == TLSF_ENGINE) {
+		int64_t blockOffset = tlsfFindBlock(address);
+		if (blockOffset < 0) return;
+		size_t memoryBegin = blockOffset + tlsfHeaderWords();	//the other tables go by where the caller's part starts, past the header
+		if (!cacheClassTags.empty()) cacheClassTags[memoryBegin] = 0;
+		if (!handleBlocks.empty()) dropHandle(memoryBegin);
+		if (!alignedBlocks.empty()) alignedBlocks.erase(memoryBegin);
+		freeCount++;
+		if (liveBitmapEnabled) markLiveBits(blockOffset, blockOffset + (tlsfTag(blockOffset) >> TLSF_TAG_BITS), false);
+		tlsfFree(blockOffset);
+		return;
+	}
+
+	auto block = findBlock(address);
+	if (block == allocatedMemory.end()) return;
+	//freeing something we didn't hand out (or already freed) does nothing
+
+	size_t memoryBegin = block->first;
+	size_t memoryEnd = memoryBegin + block->second;		//memoryEnd is the first byte not allocated
+	if (!cacheClassTags.empty()) cacheClassTags[memoryBegin] = 0;	//back in the arena, so it isn't a cache block any more
+	if (!handleBlocks.empty()) dropHandle(memoryBegin);		//freed by address instead of freeHandle, the handle goes with it
+	if (!alignedBlocks.empty()) alignedBlocks.erase(memoryBegin);
+	allocatedMemory.erase(block);
+	freeCount++;
+	if (heapFile != -1) markHeapDirty();
+	//for allocated memory, all we need to do is delete the tracker for the piece of memory we just freed
+	if (liveBitmapEnabled) markLiveBits(memoryBegin, memoryEnd, false);
+
+	if (arenaEngine == BUDDY_ENGINE) {
+		buddyFree(memoryBegin, memoryEnd - memoryBegin);
+		return;
+	}
+
+	returnToHoles(memoryBegin, memoryEnd);
+	//that's all the functionalty and this doesn't need to reutrn anything, so just exit
+}
+
+//turn the words from memoryBegin to memoryEnd into a hole, merged with the holes on either side of it
+void MemoryManager::returnToHoles(size_t memoryBegin, size_t memoryEnd) {
+	size_t sizeOfNewHole = memoryEnd - memoryBegin;
+	addHole(memoryBegin, sizeOfNewHole);
+	//there's a hole where the memory we're giving back was
 	//we make the new hole, and then combine if necessary
 
 	auto newHole = holes.find(memoryBegin);
 	if (newHole != holes.begin()) {		//make sure there's a preceeding hole before we compare to it
 		auto prevHole = std::prev(newHole);
-		int prevHoleEnd = prevHole->first + prevHole->second;
+		size_t prevHoleEnd = prevHole->first + prevHole->second;
 		if (prevHoleEnd == newHole->first) {	//if the first bit after the preceeding hole equals the beginning of the new hole, they need to be combined
-			int combinedHoleBegin = prevHole->first;
-			int combinedHoleLength = prevHole->second + newHole->second;	//the combined hole is as long as both old ones put together
-			holes.erase(newHole);
-			holes.erase(prevHole);		//remove the two previous holes
-			holes[combinedHoleBegin] = combinedHoleLength;	//put in the new one
+			size_t combinedHoleBegin = prevHole->first;
+			size_t combinedHoleLength = prevHole->second + newHole->second;	//the combined hole is as long as both old ones put together
+			removeHole(newHole);
+			removeHole(prevHole);		//remove the two previous holes
+			addHole(combinedHoleBegin, combinedHoleLength);	//put in the new one
 			//we could really just change the value corresponding to the previous hole's offset, but this feels clearer
 			newHole = holes.find(combinedHoleBegin);	//set the iterator pointing to the new hole to the combined hole, since we still need to check the following hole
 		}
@@ -135,29 +723,605 @@ void MemoryManager::free(void* address) {
 
 	auto nextHole = std::next(newHole);
 	if (nextHole != holes.end()) {		//make sure there is a next hole before we go in
-		int newHoleEnd = newHole->first + newHole->second;
+		size_t newHoleEnd = newHole->first + newHole->second;
 		if (newHoleEnd == nextHole->first) {		//similar to above: if the end of the new hole is directly followed by the start of the next hole, combine them
-			int combinedHoleBegin = newHole->first;
-			int combinedHoleLength = newHole->second + nextHole->second;
-			holes.erase(newHole);
-			holes.erase(nextHole);
-			holes[combinedHoleBegin] = combinedHoleLength;
+			size_t combinedHoleBegin = newHole->first;
+			size_t combinedHoleLength = newHole->second + nextHole->second;
+			removeHole(newHole);
+			removeHole(nextHole);
+			addHole(combinedHoleBegin, combinedHoleLength);
 			//don't need to reset newHole here, since where are no more checks
 		}
 	}
-	//that's all the functionalty and this doesn't need to reutrn anything, so just exit
+
+	if (pageReleaseBytes != 0) {
+		auto mergedHole = std::prev(holes.upper_bound(memoryBegin));
+		releasePages(mergedHole->first, mergedHole->first + mergedHole->second, memoryBegin, memoryEnd);
+	}
+}
+
+//like realloc: the block keeps its contents up to the smaller of the two sizes, and moves only if it can't be resized where it is
+//a null address is just an allocate, and a size of 0 frees the block and returns null
+//if there's nowhere to put the bigger block, null comes back and the old block is still allocated, untouched
+//a block from allocate(size, alignment) stays that aligned, whether it's resized in place or moved
+void* MemoryManager::reallocate(void* address, size_t newSizeInBytes) {
+	if (address == nullptr) return allocate(newSizeInBytes);
+	if (newSizeInBytes == 0) {
+		free(address);
+		return nullptr;
+	}
+	if (traceFile == nullptr) return reallocateBlock(address, newSizeInBytes);
+
+	uint64_t newId;
+	uint64_t oldId = traceReallocate(address, newSizeInBytes, newId);
+	void* block = reallocateBlock(address, newSizeInBytes);
+	if (block != nullptr) traceResult(block, newId);
+	else traceResult(address, oldId);	//failed, so the old block is still there under its old id
+	return block;
+}
+
+void* MemoryManager::reallocateBlock(void* address, size_t newSizeInBytes) {
+	auto lock = lockCentral();
+	int64_t blockOffset = -1;
+	size_t oldSizeInWords = 0;
+	if (arenaEngine == TLSF_ENGINE) {
+		int64_t tlsfBlock = tlsfFindBlock(address);
+		if (tlsfBlock >= 0) {
+			blockOffset = tlsfBlock + tlsfHeaderWords();
+			oldSizeInWords = (tlsfTag(tlsfBlock) >> TLSF_TAG_BITS) - tlsfHeaderWords();
+		}
+		//from here on the block is the part after the header, the same as what allocate handed out
+	}
+	else {
+		auto block = findBlock(address);
+		if (block != allocatedMemory.end()) {
+			blockOffset = block->first;
+			oldSizeInWords = block->second;
+		}
+	}
+	if (blockOffset < 0) return nullptr;	//not something we handed out
+	void* blockStart = addressOf(blockOffset);
+	size_t leadingBytes = static_cast<char*>(address) - static_cast<char*>(blockStart);
+	if (newSizeInBytes > memorySizeInWords * bytesPerWord - leadingBytes) {
+		reallocationStats.failed++;
+		failedAllocationCount++;
+		return nullptr;
+	}
+	//more than the rest of the arena can never fit, and rounding a size that big up to words would wrap round to a small one
+	size_t newSizeInWords = (leadingBytes + newSizeInBytes + bytesPerWord - 1) / bytesPerWord;
+	//an aligned block on buddy or TLSF starts partway into its block, so the caller's bytes run from there, not from the block's start.
+	//resizing in place keeps that offset (and so the alignment), and the new size is counted from it
+
+	bool cacheBlock = !cacheClassTags.empty() && cacheClassTags[blockOffset] != 0;
+	//a thread cache block has to stay the size of its class, so it can only ever move (unless it's already the right size)
+	if (newSizeInWords == oldSizeInWords || (!cacheBlock && resizeInPlace(blockStart, newSizeInWords))) {
+		reallocationStats.inPlace++;
+		return address;
+	}
+
+	auto alignedBlock = alignedBlocks.find(blockOffset);
+	void* newBlock;
+	if (alignedBlock == alignedBlocks.end()) newBlock = allocateUnlocked(newSizeInBytes);
+	else newBlock = allocateAlignedUnlocked(newSizeInBytes, alignedBlock->second);
+	//wherever it goes, it has to be as aligned as it was asked to be the first time
+	if (newBlock == nullptr) {
+		reallocationStats.failed++;
+		failedAllocationCount++;
+		return nullptr;
+	}
+	memcpy(newBlock, address, std::min(oldSizeInWords * bytesPerWord - leadingBytes, newSizeInBytes));
+	freeUnlocked(blockStart);
+	reallocationStats.moved++;
+	return newBlock;
+	//allocating before freeing means the new block never overlaps the old one, so a plain copy is safe
+}
+
+//change the length of the block starting at address without moving it. false if the space after it isn't free
+//shrinking always works on the hole map and TLSF, and on buddy whenever it crosses a power of two
+bool MemoryManager::resizeInPlace(void* address, size_t newSizeInWords) {
+	size_t blockOffset = wordOffsetOf(address);
+
+	if (arenaEngine == TLSF_ENGINE) {
+		blockOffset -= tlsfHeaderWords();
+		uint64_t tag = tlsfTag(blockOffset);
+		size_t oldLength = tag >> TLSF_TAG_BITS;
+		size_t newLength = std::max(newSizeInWords + tlsfHeaderWords(), tlsfMinimumBlock());
+		if (newLength <= oldLength) {
+			if (oldLength - newLength < tlsfMinimumBlock()) return true;	//too little to come off as a free block, so the block keeps it
+			if (liveBitmapEnabled) markLiveBits(blockOffset + newLength, blockOffset + oldLength, false);
+			tlsfSetTags(blockOffset + newLength, oldLength - newLength, 0);
+			tlsfSetTags(blockOffset, newLength, tag & TLSF_PREVIOUS_FREE_TAG);
+			tlsfFree(blockOffset + newLength);
+			return true;
+		}
+		//split the tail off as a block of its own and free it, which merges it with whatever's free after it
+
+		size_t nextOffset = blockOffset + oldLength;
+		if (nextOffset >= memorySizeInWords || !(tlsfTag(nextOffset) & TLSF_FREE_TAG)) return false;
+		size_t nextLength = tlsfTag(nextOffset) >> TLSF_TAG_BITS;
+		if (oldLength + nextLength < newLength) return false;
+
+		tlsfRemoveFree(nextOffset);
+		tlsfMarkStart(nextOffset, false);
+		if (oldLength + nextLength - newLength >= tlsfMinimumBlock()) tlsfInsertFree(blockOffset + newLength, oldLength + nextLength - newLength);
+		else newLength = oldLength + nextLength;
+		tlsfSetTags(blockOffset, newLength, tag & TLSF_PREVIOUS_FREE_TAG);
+		//the leftover can't have a free block after it, for the same reason as in tlsfAllocate
+		if (liveBitmapEnabled) markLiveBits(nextOffset, blockOffset + newLength, true);
+		return true;
+	}
+
+	auto block = allocatedMemory.find(blockOffset);
+	size_t oldLength = block->second;
+
+	if (arenaEngine == BUDDY_ENGINE) {
+		size_t newLength = 1;
+		while (newLength < newSizeInWords) newLength *= 2;
+		if (newLength == oldLength) return true;	//still fits the same power of two
+
+		if (newLength < oldLength) {
+			if (liveBitmapEnabled) markLiveBits(blockOffset + newLength, blockOffset + oldLength, false);
+			for (size_t length = oldLength / 2; length >= newLength; length /= 2) buddyFree(blockOffset + length, length);
+			block->second = newLength;
+			return true;
+		}
+		//give back the back half until it's small enough. each half's buddy is the front half we're keeping, so none of them merge
+
+		for (size_t length = oldLength; length < newLength; length *= 2) {
+			if (blockOffset % (length * 2) != 0 || !buddyIsFree(blockOffset + length, __builtin_ctzll(length))) return false;
+		}
+		for (size_t length = oldLength; length < newLength; length *= 2) buddyRemoveFree(blockOffset + length, __builtin_ctzll(length));
+		//only possible while we're the front half and the back half is one whole free block, at every size up to the new one
+		//check all the way up before taking anything, so a failure leaves the lists alone
+		if (liveBitmapEnabled) markLiveBits(blockOffset + oldLength, blockOffset + newLength, true);
+		block->second = newLength;
+		return true;
+	}
+
+	if (newSizeInWords < oldLength) {
+		if (heapFile != -1) markHeapDirty();
+		block->second = newSizeInWords;
+		if (liveBitmapEnabled) markLiveBits(blockOffset + newSizeInWords, blockOffset + oldLength, false);
+		returnToHoles(blockOffset + newSizeInWords, blockOffset + oldLength);
+		return true;
+	}
+	//the tail becomes a hole, merged into the hole after it if there is one
+
+	auto nextHole = holes.find(blockOffset + oldLength);
+	if (nextHole == holes.end() || oldLength + nextHole->second < newSizeInWords) return false;
+	if (heapFile != -1) markHeapDirty();
+	size_t holeEnd = nextHole->first + nextHole->second;
+	removeHole(nextHole);
+	if (blockOffset + newSizeInWords < holeEnd) addHole(blockOffset + newSizeInWords, holeEnd - (blockOffset + newSizeInWords));
+	if (liveBitmapEnabled) markLiveBits(blockOffset + oldLength, blockOffset + newSizeInWords, true);
+	block->second = newSizeInWords;
+	return true;
+	//holes are always merged, so if the hole right after us isn't big enough, nothing is
+}
+
+ReallocationStats MemoryManager::getReallocationStats() {
+	auto lock = lockCentral();
+	return reallocationStats;
+}
+
+//allocate a block the compactor is allowed to move. the handle stays the same wherever the block goes, 0 means it failed
+//free it with freeHandle, or free on its current address. if reallocate has to move it, it comes back as a normal block
+//the handle is the slot's generation in the top 32 bits and its index + 1 in the bottom, so no valid handle is 0
+uint64_t MemoryManager::allocateHandle(size_t sizeInBytes) {
+	auto lock = lockCentral();
+	if (!isInitialized) return 0;
+	void* block = allocateUnlocked(std::max(sizeInBytes, static_cast<size_t>(1)));
+	if (block == nullptr) {
+		failedAllocationCount++;
+		return 0;
+	}
+	//always the central path in thread safe mode. a block in a thread cache can't be moved out from under it
+
+	uint32_t slot;
+	if (!freeHandleSlots.empty()) {
+		slot = freeHandleSlots.back();
+		freeHandleSlots.pop_back();
+	}
+	else {
+		slot = static_cast<uint32_t>(handleSlots.size());
+		handleSlots.push_back(HandleSlot());
+		handleSlots[slot].generation = 0;
+	}
+	handleSlots[slot].offset = wordOffsetOf(block);
+	handleSlots[slot].live = true;
+	handleBlocks[handleSlots[slot].offset] = slot;
+	return (static_cast<uint64_t>(handleSlots[slot].generation) << 32) | (slot + 1);
+}
+
+//the block's current address. only good until the next compact, so look it up again after that instead of keeping it
+//null for a handle that's been freed (or was never ours)
+void* MemoryManager::resolveHandle(uint64_t handle) {
+	auto lock = lockCentral();
+	int64_t blockOffset = handleOffset(handle);
+	return blockOffset < 0 ? nullptr : addressOf(blockOffset);
+}
+
+void MemoryManager::freeHandle(uint64_t handle) {
+	auto lock = lockCentral();
+	int64_t blockOffset = handleOffset(handle);
+	if (blockOffset >= 0) freeUnlocked(addressOf(blockOffset));	//which lets go of the slot through dropHandle
+}
+
+int64_t MemoryManager::handleOffset(uint64_t handle) {
+	size_t slot = (handle & 0xffffffff) - 1;
+	if ((handle & 0xffffffff) == 0 || slot >= handleSlots.size()) return -1;
+	if (!handleSlots[slot].live || handleSlots[slot].generation != (handle >> 32)) return -1;
+	return handleSlots[slot].offset;
+}
+
+void MemoryManager::dropHandle(size_t blockOffset) {
+	auto handleBlock = handleBlocks.find(blockOffset);
+	if (handleBlock == handleBlocks.end()) return;
+	HandleSlot& slot = handleSlots[handleBlock->second];
+	slot.live = false;
+	slot.generation++;
+	freeHandleSlots.push_back(handleBlock->second);
+	handleBlocks.erase(handleBlock);
+}
+
+//slide handle blocks down into the hole just below them, so the holes on either side join up. a normal block stops the slide,
+//and the compactor carries on from the next hole past it. with a budget, it stops after that many microseconds
+//and the next call carries on where this one left off, so it can run a slice at a time between other work
+//only the hole map engine compacts. the other engines' blocks have to stay where their size puts them, so the report is all they get
+CompactionReport MemoryManager::compact(size_t budgetMicroseconds) {
+	auto lock = lockCentral();
+	CompactionReport report = CompactionReport();
+	measureFragmentation(report.holesBefore, report.largestHoleBefore, report.fragmentationBefore);
+
+	auto start = std::chrono::steady_clock::now();
+	while (arenaEngine == HOLE_MAP_ENGINE && isInitialized) {
+		auto hole = holes.lower_bound(compactionCursor);
+		if (hole == holes.end() || handleBlocks.empty()) {
+			report.finished = true;
+			compactionCursor = 0;
+			break;
+		}
+
+		size_t holeBegin = hole->first;
+		size_t blockOffset = hole->first + hole->second;
+		auto handleBlock = handleBlocks.find(blockOffset);
+		if (handleBlock == handleBlocks.end()) compactionCursor = blockOffset;
+		//pinned, or the hole runs to the end of the arena. either way, on to the next hole
+		else {
+			auto block = allocatedMemory.find(blockOffset);
+			size_t blockLength = block->second;
+			memmove(addressOf(holeBegin), addressOf(blockOffset), blockLength * bytesPerWord);
+			//memmove, since a block longer than the hole overlaps where it's going
+
+			allocatedMemory.erase(block);
+			allocatedMemory[holeBegin] = blockLength;
+			uint32_t slot = handleBlock->second;
+			handleBlocks.erase(handleBlock);
+			handleBlocks[holeBegin] = slot;
+			handleSlots[slot].offset = holeBegin;
+			if (heapFile != -1) markHeapDirty();
+			if (liveBitmapEnabled) {
+				markLiveBits(blockOffset, blockOffset + blockLength, false);
+				markLiveBits(holeBegin, holeBegin + blockLength, true);
+			}
+			removeHole(hole);
+			returnToHoles(holeBegin + blockLength, blockOffset + blockLength);
+			//the hole is now above the block, merged with whatever hole was above it already
+
+			compactionCursor = holeBegin + blockLength;
+			report.blocksMoved++;
+			report.wordsMoved += blockLength;
+		}
+
+		if (budgetMicroseconds != 0 && std::chrono::steady_clock::now() - start >= std::chrono::microseconds(budgetMicroseconds)) break;
+	}
+
+	measureFragmentation(report.holesAfter, report.largestHoleAfter, report.fragmentationAfter);
+	return report;
+}
+
+void MemoryManager::measureFragmentation(size_t& holeCount, size_t& largestHole, double& fragmentation) {
+	holeCount = freeBlockCount;
+	largestHole = largestFreeBlock();
+	fragmentation = freeWordCount == 0 ? 0 : 1 - static_cast<double>(largestHole) / freeWordCount;
+}
+//from the running counts, so measuring doesn't eat into a compaction slice
+
+void MemoryManager::countFreeBlock(size_t length, bool added) {
+	size_t bucket = length == 0 ? 0 : 63 - __builtin_clzll(length);
+	if (added) {
+		freeWordCount += length;
+		freeBlockCount++;
+		freeBlockHistogram[bucket]++;
+	}
+	else {
+		freeWordCount -= length;
+		freeBlockCount--;
+		freeBlockHistogram[bucket]--;
+	}
+}
+
+size_t MemoryManager::largestFreeBlock() {
+	if (arenaEngine == BUDDY_ENGINE) return buddyNonEmptyOrders == 0 ? 0 : static_cast<size_t>(1) << (63 - __builtin_clzll(buddyNonEmptyOrders));
+	if (arenaEngine == TLSF_ENGINE) {
+		if (tlsfFirstLevel == 0) return 0;
+		size_t firstLevel = 63 - __builtin_clzll(tlsfFirstLevel);
+		size_t secondLevel = 31 - __builtin_clz(tlsfSecondLevel[firstLevel]);
+		size_t topBlock = tlsfHeads[firstLevel * TLSF_SL_COUNT + secondLevel];
+		if (tlsfNextFree(topBlock) == TLSF_NO_BLOCK) {
+			tlsfLargest = tlsfTag(topBlock) >> TLSF_TAG_BITS;
+			tlsfLargestKnown = true;
+		}
+		if (tlsfLargestKnown) return tlsfLargest;
+		return firstLevel == 0 ? secondLevel : (TLSF_SL_COUNT + secondLevel) << (firstLevel - 1);
+	}
+	//the level bitmaps find the highest list straight away. when it only has one block, that's the largest. otherwise it's the
+	//running maximum, unless a block that long has left the lists since, and then it's the smallest size that list takes,
+	//which is within 1/16th of the real answer. checking every block on the list would be exact, but not constant time
+	return holesBySize.empty() ? 0 : holesBySize.rbegin()->first;
+}
+
+//everything is a running count, so this is constant time whatever the state of the arena. cheap enough to poll
+MemoryTelemetry MemoryManager::getTelemetry() {
+	auto lock = lockCentral();
+	MemoryTelemetry telemetry;
+	telemetry.arenaWords = memorySizeInWords;
+	telemetry.freeWords = freeWordCount;
+	memcpy(telemetry.holeSizeHistogram, freeBlockHistogram, sizeof(freeBlockHistogram));
+	measureFragmentation(telemetry.holeCount, telemetry.largestHole, telemetry.fragmentation);
+	telemetry.allocations = allocationCount;
+	telemetry.frees = freeCount;
+	telemetry.failedAllocations = failedAllocationCount;
+	return telemetry;
+}
+
+std::string MemoryManager::getTelemetryJson() {
+	MemoryTelemetry telemetry = getTelemetry();
+	size_t buckets = TELEMETRY_BUCKETS;
+	while (buckets > 0 && telemetry.holeSizeHistogram[buckets - 1] == 0) buckets--;
+	//only up to the biggest bucket in use, the rest would just be a long run of zeros
+
+	std::string histogram;
+	for (size_t i = 0; i < buckets; i++) histogram += (i == 0 ? "" : ", ") + std::to_string(telemetry.holeSizeHistogram[i]);
+	return "{\"wordSize\": " + std::to_string(bytesPerWord) +
+		", \"arenaWords\": " + std::to_string(telemetry.arenaWords) +
+		", \"freeWords\": " + std::to_string(telemetry.freeWords) +
+		", \"largestHole\": " + std::to_string(telemetry.largestHole) +
+		", \"holeCount\": " + std::to_string(telemetry.holeCount) +
+		", \"holeSizeHistogram\": [" + histogram + "]" +
+		", \"fragmentation\": " + std::to_string(telemetry.fragmentation) +
+		", \"allocations\": " + std::to_string(telemetry.allocations) +
+		", \"frees\": " + std::to_string(telemetry.frees) +
+		", \"failedAllocations\": " + std::to_string(telemetry.failedAllocations) + "}";
+}
+//one line, sizes in words. histogram entry n is the number of holes from 2^n to 2^(n+1) - 1 words long
+
+//record every allocate, free and reallocate from here on to a trace file, for replaying later (see TraceReplay.cpp)
+//0 if it's recording, -1 if the file couldn't be opened. start and stop it while no other thread is using the manager
+int MemoryManager::startTrace(char* filename) {
+	stopTrace();
+	traceFile = std::fopen(filename, "wb");
+	if (traceFile == nullptr) return -1;
+
+	uint8_t wordSize[10];
+	std::fwrite(TRACE_MAGIC, 1, strlen(TRACE_MAGIC), traceFile);
+	std::fwrite(wordSize, 1, encodeVarint(bytesPerWord, wordSize), traceFile);
+	nextTraceId = 1;
+	traceIds.clear();
+	traceThreads.clear();
+	return 0;
+}
+
+int MemoryManager::stopTrace() {
+	if (traceFile == nullptr) return 0;
+	int result = std::fclose(traceFile) == 0 ? 0 : -1;
+	traceFile = nullptr;
+	traceIds.clear();
+	traceThreads.clear();
+	return result;
+}
+
+void MemoryManager::traceAllocate(void* address, size_t sizeInBytes, size_t alignment) {
+	std::lock_guard<std::mutex> lock(traceLock);
+	uint64_t blockId = nextTraceId++;
+	if (alignment == 0) writeTraceRecord(TRACE_ALLOCATE, {traceThread(), blockId, sizeInBytes});
+	else writeTraceRecord(TRACE_ALIGNED_ALLOCATE, {traceThread(), blockId, sizeInBytes, alignment});
+	if (address != nullptr) traceIds[address] = blockId;
+}
+//failed allocations are recorded too, so a replay with more room can see what would have happened
+
+void MemoryManager::traceFree(void* address, bool findStart) {
+	if (address == nullptr) return;
+	std::unique_lock<std::mutex> lock(traceLock);
+	auto traced = traceIds.find(address);
+	if (traced == traceIds.end() && findStart) {
+		lock.unlock();
+		void* blockStart = getAllocationStart(address);		//takes centralLock, so not while holding traceLock
+		lock.lock();
+		traced = traceIds.find(blockStart);
+	}
+	if (traced == traceIds.end()) return;	//allocated before the trace started, or not ours
+	writeTraceRecord(TRACE_FREE, {traceThread(), traced->second});
+	traceIds.erase(traced);
+}
+
+uint64_t MemoryManager::traceReallocate(void* address, size_t newSizeInBytes, uint64_t& newId) {
+	std::lock_guard<std::mutex> lock(traceLock);
+	newId = 0;
+	auto traced = traceIds.find(address);
+	if (traced == traceIds.end()) return 0;		//allocated before the trace started, so the replay won't have it either
+	newId = nextTraceId++;
+	uint64_t oldId = traced->second;
+	traceIds.erase(traced);
+	writeTraceRecord(TRACE_REALLOCATE, {traceThread(), oldId, newId, newSizeInBytes});
+	return oldId;
 }
+//the old address stops being tracked before the reallocate, since a move frees it and another thread could get it straight away
+
+void MemoryManager::traceResult(void* address, uint64_t blockId) {
+	if (blockId == 0) return;
+	std::lock_guard<std::mutex> lock(traceLock);
+	traceIds[address] = blockId;
+}
+
+void MemoryManager::writeTraceRecord(uint8_t event, std::initializer_list<uint64_t> fields) {
+	uint8_t record[1 + 10 * 5];
+	size_t length = 0;
+	record[length++] = event;
+	for (uint64_t field : fields) length += encodeVarint(field, record + length);
+	std::fwrite(record, 1, length, traceFile);
+	//fwrite buffers, so this is a memcpy most of the time
+}
+
+size_t MemoryManager::encodeVarint(uint64_t value, uint8_t* bytes) {
+	size_t length = 0;
+	while (value >= 0x80) {
+		bytes[length++] = static_cast<uint8_t>(value) | 0x80;
+		value >>= 7;
+	}
+	bytes[length++] = static_cast<uint8_t>(value);
+	return length;
+}
+
+uint64_t MemoryManager::traceThread() {
+	auto thread = traceThreads.find(std::this_thread::get_id());
+	if (thread != traceThreads.end()) return thread->second;
+	uint64_t index = traceThreads.size();
+	traceThreads[std::this_thread::get_id()] = index;
+	return index;
+}
+
 
 void MemoryManager::setAllocator(std::function<int(int, void*)> allocator) {
 	allocatorFunction = allocator;
+	chooseStrategy(allocatorFunction);
+	indexFirstFit();
+}
+
+void MemoryManager::setViewAllocator(std::function<int64_t(size_t, const HoleView&)> allocator) {
+	if (!allocator) return;		//nothing to call, so keep the strategy we have, like setFitStrategy does
+	viewAllocatorFunction = allocator;
+	fitStrategy = CUSTOM_VIEW_FIT;
+	indexFirstFit();
+}
+//same idea as setAllocator, but the allocator reads our holes directly instead of a malloc'd copy
+
+void MemoryManager::setWideAllocator(std::function<int64_t(size_t, void*)> allocator) {
+	if (!allocator) return;		//same as setViewAllocator
+	wideAllocatorFunction = allocator;
+	fitStrategy = CUSTOM_WIDE_FIT;
+	indexFirstFit();
+}
+//list allocator for arenas past SIZE_LIMIT. it gets getWideList's format instead of getList's
+
+void MemoryManager::setWideOffsets(bool wide) {
+	arenaLimitInWords = wide ? WIDE_SIZE_LIMIT : SIZE_LIMIT;
+}
+//only changes what the next initialize will accept. everything inside already tracks offsets as size_t,
+//the 16 bit limit is only there so getList and getBitmap keep working
+
+void MemoryManager::setFitStrategy(FitStrategy strategy) {
+	if (strategy == BITMAP_FIRST_FIT) setLiveBitmap(true);
+	if (strategy == CUSTOM_FIT && !allocatorFunction) return;	//nothing to hand the list to
+	if (strategy == CUSTOM_VIEW_FIT && !viewAllocatorFunction) return;
+	if (strategy == CUSTOM_WIDE_FIT && !wideAllocatorFunction) return;
+	fitStrategy = strategy;
+	indexFirstFit();
+}
+
+FitStrategy MemoryManager::getFitStrategy() {
+	return fitStrategy;
+}
+
+ArenaEngine MemoryManager::getArenaEngine() {
+	return arenaEngine;
+}
+
+//how long an arena has to be for one allocate of sizeInBytes to fit in it straight after initialize
+//more than the request itself when the engine needs room around it: a TLSF block has its header word (and is never under the
+//minimum block), and a buddy block is a power of two. an empty TLSF arena is one free block, which the lookup always finds
+size_t MemoryManager::minimumArenaWords(size_t sizeInBytes, unsigned wordSize, ArenaEngine engine) {
+	size_t sizeInWords = std::max(sizeInBytes / wordSize + (sizeInBytes % wordSize != 0 ? 1 : 0), static_cast<size_t>(1));
+	if (sizeInWords > WIDE_SIZE_LIMIT) return sizeInWords;	//too big for any arena, whatever gets added
+	if (engine == TLSF_ENGINE && wordSize >= sizeof(uint64_t)) return std::max(sizeInWords + 1, static_cast<size_t>(TLSF_IN_BLOCK_MIN_WORDS));
+	if (engine == BUDDY_ENGINE) {
+		size_t blockWords = 1;
+		while (blockWords < sizeInWords) blockWords *= 2;
+		return blockWords;
+	}
+	return sizeInWords;
+}
+
+void MemoryManager::chooseStrategy(std::function<int(int, void*)>& allocator) {
+	int (**target)(int, void*) = allocator.target<int(*)(int, void*)>();
+	if (target && *target == bestFit) fitStrategy = BEST_FIT;
+	else if (target && *target == worstFit) fitStrategy = WORST_FIT;
+	else fitStrategy = CUSTOM_FIT;
+}
+//if we were handed our own bestFit or worstFit, use the indexed version instead. it picks the exact same hole, just without the scan
+//anything else (including a lambda wrapping bestFit) is a custom allocator and gets the list like before
+
+void MemoryManager::indexFirstFit() {
+	bool indexed = (fitStrategy == FIRST_FIT);
+	if (indexed == (firstFitHoles != nullptr)) return;
+	firstFitHoles.reset(indexed ? new FirstFitIndex() : nullptr);
+	if (indexed) {
+		for (auto iter = holes.begin(); iter != holes.end(); iter++) firstFitHoles->insert(*iter);
+	}
+}
+//called whenever the strategy changes. the index is one more tree for every hole change to update,
+//so it's only kept while first fit is what uses it: built from the holes when we switch to first fit, dropped when we switch away
+
+void MemoryManager::addHole(size_t offset, size_t length) {
+	holes[offset] = length;
+	holesBySize.insert(std::make_pair(length, offset));
+	if (firstFitHoles) firstFitHoles->insert(std::make_pair(offset, length));
+	countFreeBlock(length, true);
+}
+
+void MemoryManager::removeHole(std::map<size_t, size_t>::iterator hole) {
+	holesBySize.erase(std::make_pair(hole->second, hole->first));
+	if (firstFitHoles) firstFitHoles->erase(hole->first);
+	countFreeBlock(hole->second, false);
+	holes.erase(hole);
+}
+//every change to the holes goes through these two, so the size index can't fall out of sync
+
+int64_t MemoryManager::findHole(size_t sizeInWords) {
+	if (holesBySize.empty() || holesBySize.rbegin()->first < sizeInWords) return -1;
+	//the biggest hole is the last one in the size index, so if it's too small nothing fits
+
+	size_t desiredSize = sizeInWords;
+	switch (fitStrategy) {
+		case BEST_FIT:
+			return holesBySize.lower_bound(std::make_pair(desiredSize, static_cast<size_t>(0)))->second;
+			//smallest hole at least as big as we need. ties go to the lowest offset, same as the bestFit scan
+
+		case WORST_FIT:
+			return holesBySize.lower_bound(std::make_pair(holesBySize.rbegin()->first, static_cast<size_t>(0)))->second;
+			//the biggest size, but the first hole with that size rather than the last, again to match worstFit
+
+		case FIRST_FIT:
+			return firstFitHoles->firstFit(desiredSize);
+			//lowest offset hole that's big enough, one trip down the index
+
+		case BITMAP_FIRST_FIT:
+			return scanFreeRun(desiredSize, 0);
+			//holes are always merged with their neighbors, so a free run in the bitmap is exactly one hole
+
+		default:
+			return -1;
+	}
 }
 
 int MemoryManager::dumpMemoryMap(char* filename) {
+	auto lock = lockCentral();
 	int file = open(filename, O_WRONLY | O_TRUNC | O_CREAT, 0644);
 	//opens the file and makes it if it doesn't exist
 	//if it does exist, it wipes it
 
 	if(file == -1)  return -1;	//if there's an error on file open, return -1
+	const std::map<size_t, size_t>& holes = currentHoles();
 	std::string output = "";
 	for(auto iter = holes.begin(); iter != holes.end(); iter++){
 		output += "[";
@@ -180,9 +1344,22 @@ int MemoryManager::dumpMemoryMap(char* filename) {
 }
 
 void* MemoryManager::getList() {
-	if (!isInitialized) {
+	auto lock = lockCentral();
+	return static_cast<void*>(buildList());
+}
+
+void* MemoryManager::getWideList() {
+	auto lock = lockCentral();
+	return static_cast<void*>(buildWideList());
+}
+//allocate needs the lists while it already holds the lock, so the real work is in buildList and buildWideList
+
+uint16_t* MemoryManager::buildList() {
+	if (!isInitialized || memorySizeInWords > SIZE_LIMIT) {
 		return nullptr;
 	}
+	//offsets past SIZE_LIMIT don't fit in 16 bits, use getWideList for those
+	const std::map<size_t, size_t>& holes = currentHoles();
 	int totalListSize = 2 * holes.size() + 1;
 	//two entries per hole, plus an entry for the size
 
@@ -201,68 +1378,908 @@ void* MemoryManager::getList() {
 		//this will increment index to 1 higher than is valid, but the for loop will then exit and index will never be used in its invalid state
 	}
 
-	return static_cast<void*>(outputList);	//have to return a void pointer, so we cast
+	return outputList;
 }
 
+uint64_t* MemoryManager::buildWideList() {
+	if (!isInitialized) {
+		return nullptr;
+	}
+	const std::map<size_t, size_t>& holes = currentHoles();
+	uint64_t* outputList = (uint64_t*)malloc(sizeof(uint64_t) * (2 * holes.size() + 1));
+	outputList[0] = holes.size();
+
+	size_t index = 1;
+	for (auto iter = holes.begin(); iter != holes.end(); iter++) {
+		outputList[index++] = iter->first;
+		outputList[index++] = iter->second;
+	}
+
+	return outputList;
+}
+//same layout as getList (count, then offset and length for each hole), but every entry is a uint64_t
+//works for any arena, not just wide ones. the caller frees it, same as getList
+
 void* MemoryManager::getBitmap() {
-	int bitmapSizeWords = memorySizeInWords;
+	auto lock = lockCentral();
+	if (memorySizeInWords > SIZE_LIMIT) return nullptr;	//the size wouldn't fit in the 2 byte header, use getWideBitmap
+	return static_cast<void*>(buildBitmap(2));
+}
+
+void* MemoryManager::getWideBitmap() {
+	auto lock = lockCentral();
+	return static_cast<void*>(buildBitmap(8));
+}
+//same bits as getBitmap, but the size at the front is 8 bytes (still little endian) so it can describe any arena
+
+uint8_t* MemoryManager::buildBitmap(int headerBytes) {
+	size_t bitmapSizeWords = memorySizeInWords;
 	if (bitmapSizeWords % 8 != 0) bitmapSizeWords += (8 - bitmapSizeWords % 8);
 	//correct the size to account for the fact that we need to hold in bytes
 
-	int bitmapSize = bitmapSizeWords / 8;	//convert the size to bytes
-	uint8_t* bitmap = (uint8_t*) malloc(bitmapSize + 2);	//allocate the bitmap, plus the two spaces for the size
+	size_t bitmapSize = bitmapSizeWords / 8;	//convert the size to bytes
+	uint8_t* bitmap = (uint8_t*) calloc(bitmapSize + headerBytes, 1);	//allocate the bitmap, plus the spaces for the size
+	//calloc so everything starts as 0 (free). that covers the holes and the padding at the end, so we only ever write the allocated runs
 
-	int lowerSizeByte = bitmapSize % 256;
-	int higherSizeByte = bitmapSize / 256;
-	
-	bitmap[0] = static_cast<uint8_t>(lowerSizeByte);
-	bitmap[1] = static_cast<uint8_t>(higherSizeByte);
+	for (int i = 0; i < headerBytes; i++) {
+		bitmap[i] = static_cast<uint8_t>((bitmapSize >> (8 * i)) & 0xFF);
+	}
+	//lowest byte of the size first. for the 2 byte header that's the same as size % 256 followed by size / 256
+
+	uint8_t* bits = bitmap + headerBytes;
+	const std::map<size_t, size_t>& holes = currentHoles();
+	size_t lastHoleEndpoint = 0;
+	for (auto iter = holes.begin(); iter != holes.end(); iter++) {
+		setBitRun(bits, lastHoleEndpoint, iter->first);		//everything between the last hole and this one is allocated
+		lastHoleEndpoint = iter->first + iter->second;
+	}
+	setBitRun(bits, lastHoleEndpoint, memorySizeInWords);	//and anything after the last hole
+
+	return bitmap;
+}
+
+//word n is bit n % 8 of byte n / 8, lowest bit first, so a run of words is a run of bits
+//only the bytes at either end of the run are partial. everything in between is all 1s, which memset fills a whole vector register at a time
+void MemoryManager::setBitRun(uint8_t* bits, size_t begin, size_t end) {
+	if (begin >= end) return;
+	size_t firstByte = begin / 8;
+	size_t lastByte = (end - 1) / 8;
+	uint8_t firstMask = static_cast<uint8_t>(0xFF << (begin % 8));
+	uint8_t lastMask = static_cast<uint8_t>(0xFF >> (7 - (end - 1) % 8));
+
+	if (firstByte == lastByte) {
+		bits[firstByte] |= firstMask & lastMask;
+		return;
+	}
+	//run starts and ends in the same byte
+
+	bits[firstByte] |= firstMask;
+	memset(bits + firstByte + 1, 0xFF, lastByte - firstByte - 1);
+	bits[lastByte] |= lastMask;
+}
+
+void MemoryManager::setLiveBitmap(bool enabled) {
+	liveBitmapEnabled = enabled;
+	if (!enabled) {
+		liveBitmap.clear();
+		liveBitmap.shrink_to_fit();
+		if (fitStrategy == BITMAP_FIRST_FIT) fitStrategy = FIRST_FIT;	//nothing left to scan, so fall back to the same policy on the hole map
+		indexFirstFit();
+	}
+	else if (isInitialized) rebuildLiveBitmap();
+}
 
-	int lastHoleEndpoint = 0;
-	int index = 2;		//index for inserting into the array, starts at 2 since the first 2 are for the size
-	std::string bitstream = "";
+void MemoryManager::rebuildLiveBitmap() {
+	liveBitmap.assign((memorySizeInWords + 63) / 64, 0);
+	const std::map<size_t, size_t>& holes = currentHoles();
+	size_t lastHoleEndpoint = 0;
 	for (auto iter = holes.begin(); iter != holes.end(); iter++) {
-		int currentHoleBegin = iter->first;
-		if (currentHoleBegin != lastHoleEndpoint) {		//only every false if memory starts with a hole, but that's good enough to have it
-			int allocatedMemorySize = currentHoleBegin - lastHoleEndpoint;		//get length of allocated memory
-			std::string memoryBits = std::string(allocatedMemorySize, '1');		//fill contrusctor, makes string with allocatedmemorysize copies of '1'
-			bitstream = memoryBits + bitstream;		//little endian, so concatenate the new bits to the front
+		markLiveBits(lastHoleEndpoint, iter->first, true);
+		lastHoleEndpoint = iter->first + iter->second;
+	}
+	markLiveBits(lastHoleEndpoint, memorySizeInWords, true);
+}
+//one full build when it gets turned on (or on initialize), after that allocate and free keep it current
+
+//same idea as setBitRun, but a 64 bit word at a time, so a run costs its length / 64
+void MemoryManager::markLiveBits(size_t begin, size_t end, bool allocated) {
+	while (begin < end) {
+		size_t word = begin / 64;
+		size_t bitInWord = begin % 64;
+		size_t bitsHere = std::min(end - begin, 64 - bitInWord);
+		uint64_t mask = (bitsHere == 64) ? ~0ull : (((1ull << bitsHere) - 1) << bitInWord);
+		if (allocated) liveBitmap[word] |= mask;
+		else liveBitmap[word] &= ~mask;
+		begin += bitsHere;
+	}
+}
+
+const uint8_t* MemoryManager::getLiveBitmap() {
+	if (!liveBitmapEnabled || liveBitmap.empty()) return nullptr;
+	return reinterpret_cast<const uint8_t*>(liveBitmap.data());
+}
+//no copy and no header, just the bits. on a little endian machine (anything we'd run on) the bytes come out in the same order
+//as getBitmap's. only good until the next initialize or shutdown
+
+size_t MemoryManager::getLiveBitmapSize() {
+	return (memorySizeInWords + 7) / 8;
+}
+//in bytes, same as the size in getBitmap's header. the vector underneath may have a few more bytes of zeroes
+
+//lowest offset at or after startWord where sizeInWords free words in a row start
+//goes a 64 bit word at a time no matter how chopped up the arena is, instead of a step per hole
+int64_t MemoryManager::findFreeRun(size_t sizeInWords, size_t startWord) {
+	auto lock = lockCentral();
+	return scanFreeRun(sizeInWords, startWord);
+}
+
+int64_t MemoryManager::scanFreeRun(size_t sizeInWords, size_t startWord) {
+	if (!liveBitmapEnabled || !isInitialized || startWord >= memorySizeInWords) return -1;
+	if (sizeInWords == 0) sizeInWords = 1;
+
+	size_t carried = 0;		//free words in a row running up to the end of the previous word
+	for (size_t word = startWord / 64; word < liveBitmap.size(); word++) {
+		uint64_t freeBits = ~liveBitmap[word];
+		if (word == startWord / 64) freeBits &= ~0ull << (startWord % 64);	//words before startWord don't count
+		if (word == liveBitmap.size() - 1 && memorySizeInWords % 64 != 0) freeBits &= (1ull << (memorySizeInWords % 64)) - 1;
+		//and neither does the padding past the end of the arena
+
+		size_t lowRun = (freeBits == ~0ull) ? 64 : __builtin_ctzll(~freeBits);
+		if (carried + lowRun >= sizeInWords) return word * 64 - carried;
+		//a run coming in from earlier words is the lowest offset we could find, so check it first
+
+		if (sizeInWords <= 64) {
+			uint64_t runStarts = freeBits;
+			size_t covered = 1;
+			while (covered < sizeInWords) {
+				size_t step = std::min(covered, sizeInWords - covered);
+				runStarts &= runStarts >> step;
+				covered += step;
+			}
+			if (runStarts != 0) return word * 64 + __builtin_ctzll(runStarts);
 		}
-		std::string holeBits = std::string(iter->second, '0');
-		bitstream = holeBits + bitstream;		//get the length of the hole, then add that many zeroes to the bitmap
+		//after this, bit i is still set only if bits i through i + sizeInWords - 1 were all free
+		//doubling the shift each time means it only takes log(sizeInWords) steps
 
-		while (bitstream.length() >= 8) {		//trim as we go to avoid bitstream getting too large
-			std::string byte = bitstream.substr(bitstream.length() - 8, 8);		//get the last 8 bits from the bitstream
-			uint8_t bitmapEntry = std::stoi(byte, nullptr, 2);		//converts the byte to an integer using base 2 (binary)
-			bitmap[index++] = bitmapEntry;	//put the entry in the bitmap and increment the index for next time
-			bitstream = bitstream.substr(0, bitstream.length() - 8);	//trim the bits we just used from the string
+		if (freeBits == ~0ull) carried += 64;
+		else carried = (freeBits == 0) ? 0 : __builtin_clzll(~freeBits);
+		//count leading zeros of the allocated bits is the free run at the top of this word, which carries into the next one
+	}
+	return -1;
+}
+
+size_t MemoryManager::countFreeWords(size_t beginWord, size_t endWord) {
+	auto lock = lockCentral();
+	if (!liveBitmapEnabled || !isInitialized) return 0;
+	endWord = std::min(endWord, memorySizeInWords);
+	size_t freeWords = 0;
+	while (beginWord < endWord) {
+		size_t word = beginWord / 64;
+		size_t bitInWord = beginWord % 64;
+		size_t bitsHere = std::min(endWord - beginWord, 64 - bitInWord);
+		uint64_t mask = (bitsHere == 64) ? ~0ull : (((1ull << bitsHere) - 1) << bitInWord);
+		freeWords += bitsHere - __builtin_popcountll(liveBitmap[word] & mask);
+		beginWord += bitsHere;
+	}
+	return freeWords;
+}
+//free words in [beginWord, endWord), counting the allocated ones with popcount
+
+const std::map<size_t, size_t>& MemoryManager::currentHoles() {
+	if (arenaEngine == HOLE_MAP_ENGINE) return holes;
+
+	reportedHoles.clear();
+	if (arenaEngine == TLSF_ENGINE) {
+		for (size_t offset = 0; offset < memorySizeInWords; offset += tlsfTag(offset) >> TLSF_TAG_BITS) {
+			if (tlsfTag(offset) & TLSF_FREE_TAG) reportedHoles.emplace_hint(reportedHoles.end(), offset, tlsfTag(offset) >> TLSF_TAG_BITS);
+		}
+		return reportedHoles;
+	}
+	//TLSF never leaves two free blocks side by side, so its free blocks already are the holes. hop from header to header
+
+	size_t lastBlockEnd = 0;
+	for (auto iter = allocatedMemory.begin(); iter != allocatedMemory.end(); iter++) {
+		if (iter->first > lastBlockEnd) reportedHoles.emplace_hint(reportedHoles.end(), lastBlockEnd, iter->first - lastBlockEnd);
+		lastBlockEnd = iter->first + iter->second;
+	}
+	if (lastBlockEnd < memorySizeInWords) reportedHoles.emplace_hint(reportedHoles.end(), lastBlockEnd, memorySizeInWords - lastBlockEnd);
+	return reportedHoles;
+}
+//the holes the same way the hole map would have them, fully merged, for the reporting functions
+//other engines don't keep their free space that way (two free buddies of different sizes can sit side by side),
+//so work it out from the gaps between allocated blocks instead
+
+void MemoryManager::buddySetup() {
+	size_t orders = 0;
+	while ((static_cast<size_t>(1) << orders) <= memorySizeInWords) orders++;
+	buddyFreeLists.assign(orders, std::set<size_t>());
+	buddyFreeBits.resize(orders);
+	for (size_t order = 0; order < orders; order++) {
+		buddyFreeBits[order].assign(((memorySizeInWords >> order) + 63) / 64, 0);
+	}
+	buddyNonEmptyOrders = 0;
+
+	size_t offset = 0;
+	for (size_t order = orders; order-- > 0;) {
+		if (memorySizeInWords & (static_cast<size_t>(1) << order)) {
+			buddyAddFree(offset, order);
+			offset += static_cast<size_t>(1) << order;
 		}
-		//this will repeat as long as there's a valid byte to process
+	}
+	//the arena doesn't have to be a power of two. one free block per set bit of the size, biggest first, covers it exactly
+	//every block's offset is a sum of bigger powers of two, so it's lined up the way buddies need to be
+}
 
-		lastHoleEndpoint = currentHoleBegin + iter->second;	//update the endpoint to process the next memory chunk
+int64_t MemoryManager::buddyAllocate(size_t& sizeInWords) {
+	size_t order = 0;
+	while ((static_cast<size_t>(1) << order) < sizeInWords) order++;
+	//smallest power of two that holds the request. a 0 word request still gets a 1 word block
+	if (order >= buddyFreeLists.size()) return -1;
+
+	uint64_t bigEnough = buddyNonEmptyOrders >> order;
+	if (bigEnough == 0) return -1;
+	size_t fromOrder = order + __builtin_ctzll(bigEnough);
+	//lowest order at or above the one we need that has a free block. one instruction instead of checking each list
+
+	size_t offset = *buddyFreeLists[fromOrder].begin();
+	buddyRemoveFree(offset, fromOrder);
+	while (fromOrder > order) {
+		fromOrder--;
+		buddyAddFree(offset + (static_cast<size_t>(1) << fromOrder), fromOrder);
 	}
+	//split down to size. each split keeps the front half and puts the back half on the list one order down
+
+	sizeInWords = static_cast<size_t>(1) << order;
+	return offset;
+}
 
-	if (lastHoleEndpoint != memorySizeInWords) {	//if the end of the last hole wasn't the length of the bitmap, then there's allocated memory at the end to add
-		int allocatedMemorySize = memorySizeInWords - lastHoleEndpoint;
-		std::string memoryBits = std::string(allocatedMemorySize, '1');
-		bitstream = memoryBits + bitstream;
+void MemoryManager::buddyFree(size_t offset, size_t length) {
+	size_t freedBegin = offset;
+	size_t freedEnd = offset + length;
+	size_t order = __builtin_ctzll(length);		//blocks are always a power of two long
+	while (order + 1 < buddyFreeLists.size()) {
+		size_t buddy = offset ^ (static_cast<size_t>(1) << order);
+		if (!buddyIsFree(buddy, order)) break;
+		buddyRemoveFree(buddy, order);
+		offset = std::min(offset, buddy);
+		order++;
 	}
+	//a block's buddy is the other half of the block it was split from, which is just the offset with bit n flipped
+	//if that whole buddy is free, take it off its list and go around again with the merged block. stop at the first one that isn't
+	buddyAddFree(offset, order);
+	if (pageReleaseBytes != 0) releasePages(offset, offset + (static_cast<size_t>(1) << order), freedBegin, freedEnd);
+	//the merged block, not the whole hole (a neighbor that isn't our buddy could be free too), but it's never wrong
+}
+
+void MemoryManager::buddyAddFree(size_t offset, size_t order) {
+	buddyFreeLists[order].insert(offset);
+	countFreeBlock(static_cast<size_t>(1) << order, true);
+	buddyFreeBits[order][(offset >> order) / 64] |= 1ull << ((offset >> order) % 64);
+	buddyNonEmptyOrders |= 1ull << order;
+}
+
+void MemoryManager::buddyRemoveFree(size_t offset, size_t order) {
+	buddyFreeLists[order].erase(offset);
+	countFreeBlock(static_cast<size_t>(1) << order, false);
+	buddyFreeBits[order][(offset >> order) / 64] &= ~(1ull << ((offset >> order) % 64));
+	if (buddyFreeLists[order].empty()) buddyNonEmptyOrders &= ~(1ull << order);
+}
+//like addHole and removeHole, the only way the buddy lists change, so the bits always match
+
+bool MemoryManager::buddyIsFree(size_t offset, size_t order) {
+	if (offset + (static_cast<size_t>(1) << order) > memorySizeInWords) return false;	//buddy hangs off the end of the arena, so it can't exist
+	return (buddyFreeBits[order][(offset >> order) / 64] >> ((offset >> order) % 64)) & 1;
+}
 
-	if (memorySizeInWords != bitmapSizeWords) {		//if the size of memory didn't divide evenly into bytes, fill the remaining space with padding zeroes
-		int paddingZeros = bitmapSizeWords - memorySizeInWords;
-		std::string padBits = std::string(paddingZeros, '0');
-		bitstream = padBits + bitstream;
+//false if the tables that go beside the arena can't be allocated
+bool MemoryManager::tlsfSetup() {
+	tlsfInBlock = bytesPerWord >= sizeof(uint64_t) && memorySizeInWords >= TLSF_IN_BLOCK_MIN_WORDS;
+	try {
+		if (!tlsfInBlock) {
+			tlsfTags.assign(memorySizeInWords, 0);
+			tlsfNext.assign(memorySizeInWords, TLSF_NO_BLOCK);
+			tlsfPrev.assign(memorySizeInWords, TLSF_NO_BLOCK);
+		}
+		tlsfStarts.assign((memorySizeInWords + 63) / 64, 0);
+		tlsfHeads.assign(TLSF_FL_COUNT * TLSF_SL_COUNT, TLSF_NO_BLOCK);
 	}
+	catch (std::bad_alloc&) {
+		return false;
+	}
+	//in block, the only table that grows with the arena is one bit per word. for small words it's 24 bytes a word, which a big arena can run out of
+	tlsfFirstLevel = 0;
+	memset(tlsfSecondLevel, 0, sizeof(tlsfSecondLevel));
+	tlsfLargest = 0;
+	tlsfLargestKnown = true;
+	if (memorySizeInWords > 0) tlsfInsertFree(0, memorySizeInWords);
+	return true;
+}
 
-	while (bitstream.length() >= 8) {		
-		std::string byte = bitstream.substr(bitstream.length() - 8, 8);		
-		uint8_t bitmapEntry = std::stoi(byte, nullptr, 2);		
-		bitmap[index++] = bitmapEntry;	
-		bitstream = bitstream.substr(0, bitstream.length() - 8);	
+//which list a block of this length goes on. sizes under 16 get a list each, bigger ones go by their top bit (first level)
+//and the 4 bits under it (second level), so every list holds sizes within 1/16th of each other
+void MemoryManager::tlsfMapping(size_t length, size_t& firstLevel, size_t& secondLevel) {
+	if (length < TLSF_SL_COUNT) {
+		firstLevel = 0;
+		secondLevel = length;
+		return;
 	}
-	//put everything not got during for loop
+	size_t topBit = 63 - __builtin_clzll(length);
+	firstLevel = topBit - TLSF_SL_BITS + 1;
+	secondLevel = (length >> (topBit - TLSF_SL_BITS)) - TLSF_SL_COUNT;
+}
+
+//sizeInWords goes in as the words the caller wants, and comes back as the length of the whole block, header included
+int64_t MemoryManager::tlsfAllocate(size_t& sizeInWords) {
+	sizeInWords = std::max(sizeInWords + tlsfHeaderWords(), tlsfMinimumBlock());
+	if (sizeInWords > memorySizeInWords) return -1;
+
+	size_t searchSize = sizeInWords;
+	if (searchSize >= TLSF_SL_COUNT) searchSize += (static_cast<size_t>(1) << (63 - __builtin_clzll(searchSize) - TLSF_SL_BITS)) - 1;
+	size_t firstLevel, secondLevel;
+	tlsfMapping(searchSize, firstLevel, secondLevel);
+	//round the size up to the start of the next list first. then anything on the list we land on is big enough,
+	//and we can take the front block without looking at any others
+
+	size_t offset = TLSF_NO_BLOCK;
+	uint32_t secondLevelMap = firstLevel < TLSF_FL_COUNT ? tlsfSecondLevel[firstLevel] & (~0u << secondLevel) : 0;
+	if (secondLevelMap == 0 && firstLevel + 1 < TLSF_FL_COUNT) {
+		uint64_t firstLevelMap = tlsfFirstLevel & (~0ull << (firstLevel + 1));
+		if (firstLevelMap != 0) {
+			firstLevel = __builtin_ctzll(firstLevelMap);
+			secondLevelMap = tlsfSecondLevel[firstLevel];
+		}
+	}
+	if (secondLevelMap != 0) offset = tlsfHeads[firstLevel * TLSF_SL_COUNT + __builtin_ctz(secondLevelMap)];
+	//a list in the same first level at or past our slice, otherwise the lowest first level above us with anything in it
+	//that's two find first set instructions no matter how many blocks there are
+
+	if (offset == TLSF_NO_BLOCK) {
+		tlsfMapping(sizeInWords, firstLevel, secondLevel);
+		size_t candidate = tlsfHeads[firstLevel * TLSF_SL_COUNT + secondLevel];
+		if (candidate == TLSF_NO_BLOCK || (tlsfTag(candidate) >> TLSF_TAG_BITS) < sizeInWords) return -1;
+		offset = candidate;
+	}
+	//rounding up skips the list the size itself is on, which could still have a block that fits (like the whole arena when it's empty)
+	//so when nothing else did, try the front block of that list. only the front one, to keep it constant time: a fitting block
+	//further down the list is missed, and that allocation fails even though there was room, the same as in any TLSF
+
+	size_t blockLength = tlsfTag(offset) >> TLSF_TAG_BITS;
+	tlsfRemoveFree(offset);
+	if (blockLength - sizeInWords >= tlsfMinimumBlock()) tlsfInsertFree(offset + sizeInWords, blockLength - sizeInWords);
+	else sizeInWords = blockLength;
+	//the leftover can't have a free neighbor: the block after it was already next to a free block, so it can't be free
+	//a leftover too small to hold a free block's tags stays on the end of this block instead
+	tlsfSetTags(offset, sizeInWords, 0);
+	return offset;
+}
+
+void MemoryManager::tlsfFree(size_t offset) {
+	uint64_t tag = tlsfTag(offset);
+	size_t length = tag >> TLSF_TAG_BITS;
+	size_t freedBegin = offset;
+	size_t freedEnd = offset + length;
+
+	if (tag & TLSF_PREVIOUS_FREE_TAG) {
+		size_t previousLength = tlsfTag(offset - 1) >> TLSF_TAG_BITS;
+		size_t previousOffset = offset - previousLength;
+		tlsfRemoveFree(previousOffset);
+		tlsfMarkStart(offset, false);
+		offset = previousOffset;
+		length += previousLength;
+	}
+	//our header says whether the block before us is free, and if it is, the word before us is its footer, which says where it starts
+
+	size_t nextOffset = offset + length;
+	if (nextOffset < memorySizeInWords && (tlsfTag(nextOffset) & TLSF_FREE_TAG)) {
+		size_t nextLength = tlsfTag(nextOffset) >> TLSF_TAG_BITS;
+		tlsfRemoveFree(nextOffset);
+		tlsfMarkStart(nextOffset, false);
+		length += nextLength;
+	}
+	//and the word after us is the header of the next block
+	//either way the block that got merged into another one doesn't start a block any more
+
+	tlsfInsertFree(offset, length);
+	if (pageReleaseBytes != 0) releasePages(offset, offset + length, freedBegin, freedEnd);
+}
+
+//the start of the allocated block address is in, or -1 if it's free, not in the arena, or on a block's header word
+int64_t MemoryManager::tlsfFindBlock(void* address) {
+	int64_t wordOffset = wordOffsetOf(address);
+	if (wordOffset < 0) return -1;
+
+	size_t word = wordOffset / 64;
+	uint64_t starts = tlsfStarts[word] & (~0ull >> (63 - wordOffset % 64));
+	while (starts == 0) starts = tlsfStarts[--word];
+	size_t offset = word * 64 + 63 - __builtin_clzll(starts);
+	//the last block start at or before the address. word 0 always starts a block, so this stops
+	//the pointer allocate handed out is right after its start, so that's nearly always in the first 64 bits we look at
+
+	if ((tlsfTag(offset) & TLSF_FREE_TAG) || static_cast<size_t>(wordOffset) < offset + tlsfHeaderWords()) return -1;
+	return offset;
+}
+
+//flags is TLSF_FREE_TAG for a free block, and TLSF_PREVIOUS_FREE_TAG if the block before it is free (which a free block's never is)
+void MemoryManager::tlsfSetTags(size_t offset, size_t length, uint64_t flags) {
+	uint64_t tag = (static_cast<uint64_t>(length) << TLSF_TAG_BITS) | flags;
+	tlsfWriteTag(offset, tag);
+	if (flags & TLSF_FREE_TAG) tlsfWriteTag(offset + length - 1, tag);
+	tlsfMarkStart(offset, true);
+	//only a free block has a footer. the block after it only looks back when its header says the block before it is free
+	//a one word free block's footer is its header, which is fine since they say the same thing
+
+	size_t nextOffset = offset + length;
+	if (nextOffset < memorySizeInWords) {
+		uint64_t nextTag = tlsfTag(nextOffset);
+		if (flags & TLSF_FREE_TAG) tlsfWriteTag(nextOffset, nextTag | TLSF_PREVIOUS_FREE_TAG);
+		else tlsfWriteTag(nextOffset, nextTag & ~static_cast<uint64_t>(TLSF_PREVIOUS_FREE_TAG));
+	}
+	//so the block after this one has to be told whether it's free now. callers tag the later block first when they split one,
+	//so there's always a real header there
+}
+
+uint64_t MemoryManager::tlsfTag(size_t offset) {
+	if (!tlsfInBlock) return tlsfTags[offset];
+	uint64_t tag;
+	memcpy(&tag, addressOf(offset), sizeof(tag));
+	return tag;
+}
+
+void MemoryManager::tlsfWriteTag(size_t offset, uint64_t tag) {
+	if (!tlsfInBlock) tlsfTags[offset] = tag;
+	else memcpy(addressOf(offset), &tag, sizeof(tag));
+}
+
+size_t MemoryManager::tlsfNextFree(size_t offset) {
+	if (!tlsfInBlock) return tlsfNext[offset];
+	size_t next;
+	memcpy(&next, addressOf(offset + 1), sizeof(next));
+	return next;
+}
+
+size_t MemoryManager::tlsfPrevFree(size_t offset) {
+	if (!tlsfInBlock) return tlsfPrev[offset];
+	size_t prev;
+	memcpy(&prev, addressOf(offset + 2), sizeof(prev));
+	return prev;
+}
 
-	return static_cast<void*>(bitmap);
+void MemoryManager::tlsfSetNextFree(size_t offset, size_t next) {
+	if (!tlsfInBlock) tlsfNext[offset] = next;
+	else memcpy(addressOf(offset + 1), &next, sizeof(next));
+}
+
+void MemoryManager::tlsfSetPrevFree(size_t offset, size_t prev) {
+	if (!tlsfInBlock) tlsfPrev[offset] = prev;
+	else memcpy(addressOf(offset + 2), &prev, sizeof(prev));
+}
+//in block, a free block's header is followed by its next link and then its previous one. memcpy, since a word
+//of 12 bytes doesn't keep them lined up on 8
+
+size_t MemoryManager::tlsfHeaderWords() {
+	return tlsfInBlock ? 1 : 0;
+}
+
+size_t MemoryManager::tlsfMinimumBlock() {
+	return tlsfInBlock ? TLSF_IN_BLOCK_MIN_WORDS : 1;
+}
+
+void MemoryManager::tlsfMarkStart(size_t offset, bool isStart) {
+	if (isStart) tlsfStarts[offset / 64] |= 1ull << (offset % 64);
+	else tlsfStarts[offset / 64] &= ~(1ull << (offset % 64));
+}
+
+void MemoryManager::tlsfInsertFree(size_t offset, size_t length) {
+	size_t firstLevel, secondLevel;
+	tlsfMapping(length, firstLevel, secondLevel);
+	size_t list = firstLevel * TLSF_SL_COUNT + secondLevel;
+
+	tlsfSetTags(offset, length, TLSF_FREE_TAG);
+	tlsfSetPrevFree(offset, TLSF_NO_BLOCK);
+	tlsfSetNextFree(offset, tlsfHeads[list]);
+	if (tlsfHeads[list] != TLSF_NO_BLOCK) tlsfSetPrevFree(tlsfHeads[list], offset);
+	tlsfHeads[list] = offset;
+
+	tlsfFirstLevel |= 1ull << firstLevel;
+	tlsfSecondLevel[firstLevel] |= 1u << secondLevel;
+	countFreeBlock(length, true);
+	if (tlsfLargestKnown) tlsfLargest = std::max(tlsfLargest, length);
+}
+
+void MemoryManager::tlsfRemoveFree(size_t offset) {
+	size_t length = tlsfTag(offset) >> TLSF_TAG_BITS;
+	size_t firstLevel, secondLevel;
+	tlsfMapping(length, firstLevel, secondLevel);
+	countFreeBlock(length, false);
+	if (length == tlsfLargest) tlsfLargestKnown = false;	//there could be another one that long, but there's no telling without looking
+	size_t list = firstLevel * TLSF_SL_COUNT + secondLevel;
+
+	size_t prev = tlsfPrevFree(offset);
+	size_t next = tlsfNextFree(offset);
+	if (prev != TLSF_NO_BLOCK) tlsfSetNextFree(prev, next);
+	else tlsfHeads[list] = next;
+	if (next != TLSF_NO_BLOCK) tlsfSetPrevFree(next, prev);
+
+	if (tlsfHeads[list] == TLSF_NO_BLOCK) {
+		tlsfSecondLevel[firstLevel] &= ~(1u << secondLevel);
+		if (tlsfSecondLevel[firstLevel] == 0) tlsfFirstLevel &= ~(1ull << firstLevel);
+	}
+}
+//the same job as addHole and removeHole, and like them the only place the lists and the bits that summarize them change
+
+void MemoryManager::setThreadSafe(bool enabled) {
+	if (enabled == threadSafe) return;
+	if (!enabled) flushThreadCache();	//takes the lock itself, so before we do
+	std::lock_guard<std::mutex> lock(centralLock);
+	if (enabled) {
+		if (isInitialized) cacheClassTags.assign(memorySizeInWords, 0);
+		threadSafe = true;
+		return;
+	}
+	threadSafe = false;
+	cacheClassTags.clear();
+	cacheClassTags.shrink_to_fit();
+}
+//switch it on before other threads start using the manager. switching it off only empties this thread's cache,
+//anything other threads still have cached just stays allocated
+
+bool MemoryManager::isThreadSafe() {
+	return threadSafe;
+}
+
+void MemoryManager::flushThreadCache() {
+	if (!threadSafe) return;
+	ThreadCache* cache = threadCache();
+	for (size_t sizeInWords = 1; sizeInWords <= THREAD_CACHE_MAX_WORDS; sizeInWords++) {
+		flushCache(cache, sizeInWords, 0);
+	}
+}
+//gives everything this thread has cached back to the arena, so the reporting functions show it as free
+//happens by itself when the thread exits
+
+std::unique_lock<std::mutex> MemoryManager::lockCentral() {
+	std::unique_lock<std::mutex> lock;
+	if (threadSafe) lock = std::unique_lock<std::mutex>(centralLock);
+	drainRemoteFrees();
+	return lock;
+}
+//the public functions that read or change the shared structures hold this for their whole body. does nothing when not thread safe
+//either way, catch up on remote frees first so what they see is current
+
+ThreadCache* MemoryManager::threadCache() {
+	for (ThreadCache* cache : threadCaches.caches) {
+		if (cache->managerId != managerId) continue;
+		if (cache->arenaGeneration != arenaGeneration) {
+			for (size_t sizeInWords = 1; sizeInWords <= THREAD_CACHE_MAX_WORDS; sizeInWords++) cache->blocks[sizeInWords].clear();
+			cache->arenaGeneration = arenaGeneration;
+		}
+		//the arena was shut down or reinitialized since we last used it, so those blocks don't exist any more
+		return cache;
+	}
+
+	{
+		std::lock_guard<std::mutex> registryLock(managerRegistryLock);
+		auto iter = threadCaches.caches.begin();
+		while (iter != threadCaches.caches.end()) {
+			if (liveManagers.count((*iter)->managerId) == 0) {
+				delete *iter;
+				iter = threadCaches.caches.erase(iter);
+			}
+			else iter++;
+		}
+	}
+	//first time this thread has used this manager. while we're here, drop caches for managers that have been destroyed
+
+	ThreadCache* cache = new ThreadCache();
+	cache->managerId = managerId;
+	cache->arenaGeneration = arenaGeneration;
+	threadCaches.caches.push_back(cache);
+	return cache;
+}
+//a thread usually only uses one or two managers, so a walk is faster than any lookup structure
+
+void MemoryManager::flushCache(ThreadCache* cache, size_t sizeInWords, size_t keep) {
+	std::vector<void*>& blocks = cache->blocks[sizeInWords];
+	if (blocks.size() <= keep) return;
+	std::unique_lock<std::mutex> lock(centralLock, std::try_to_lock);
+	if (lock.owns_lock()) drainRemoteFrees();
+	while (blocks.size() > keep) {
+		if (lock.owns_lock()) freeUnlocked(blocks.back());
+		else pushRemoteFree(blocks.back());
+		blocks.pop_back();
+	}
+}
+//hands cached blocks back to the arena in one go under a single lock. freeUnlocked clears their tags
+//if the lock's busy they go on the remote free stack instead, so a free never waits
+
+void MemoryManager::freeRemote(void* address) {
+	if (address == nullptr) return;
+	if (threadSafe) {
+		free(address);
+		return;
+	}
+	if (traceFile != nullptr) traceFree(address, false);	//only the exact address, anything more would mean reading the arena
+	pushRemoteFree(address);
+}
+//free from a thread that doesn't own the manager. never takes a lock or touches the arena's structures,
+//the owner does the actual free on its next allocate (or anything else that reads the arena)
+//in thread safe mode free already never waits, so this is just free
+
+void MemoryManager::pushRemoteFree(void* address) {
+	int64_t wordOffset = wordOffsetOf(address);
+	if (wordOffset < 0) return;		//not ours, and free would ignore it anyway
+	void* entry = addressOf(wordOffset);
+	//the start of the word it's in, which is in the same block, and has at least a whole word after it to write the link into
+
+	if (bytesPerWord < sizeof(void*)) {
+		RemoteFreeNode* node = new RemoteFreeNode();
+		node->address = entry;
+		entry = node;
+	}
+
+	void* head = remoteFrees.load(std::memory_order_relaxed);
+	do {
+		if (bytesPerWord < sizeof(void*)) static_cast<RemoteFreeNode*>(entry)->next = static_cast<RemoteFreeNode*>(head);
+		else memcpy(entry, &head, sizeof(void*));
+	} while (!remoteFrees.compare_exchange_weak(head, entry, std::memory_order_release, std::memory_order_relaxed));
+	//point at the current top, then swap ourselves in as long as the top hasn't changed. if it has, head now holds the new top, try again
+	//nothing is ever popped one at a time, only taken all at once, so the top can't be swapped out and back in behind our back
+}
+
+void MemoryManager::drainRemoteFrees() {
+	if (remoteFrees.load(std::memory_order_relaxed) == nullptr) return;
+	void* entry = remoteFrees.exchange(nullptr, std::memory_order_acquire);
+	//take the whole stack in one go. the pushes that made it are all visible to us after this
+	while (entry != nullptr) {
+		void* next;
+		void* address = entry;
+		if (bytesPerWord < sizeof(void*)) {
+			RemoteFreeNode* node = static_cast<RemoteFreeNode*>(entry);
+			next = node->next;
+			address = node->address;
+			delete node;
+		}
+		else memcpy(&next, entry, sizeof(void*));
+		freeUnlocked(address);
+		entry = next;
+	}
+}
+//only ever called by whoever is allowed to touch the arena right now: the owner, or the holder of the lock in thread safe mode
+
+ThreadCacheSet::~ThreadCacheSet() {
+	std::lock_guard<std::mutex> registryLock(managerRegistryLock);
+	for (ThreadCache* cache : caches) {
+		auto manager = liveManagers.find(cache->managerId);
+		if (manager != liveManagers.end()) {
+			MemoryManager* owner = manager->second;
+			std::lock_guard<std::mutex> lock(owner->centralLock);
+			if (owner->threadSafe && owner->arenaGeneration == cache->arenaGeneration) {
+				owner->drainRemoteFrees();
+				for (size_t sizeInWords = 1; sizeInWords <= THREAD_CACHE_MAX_WORDS; sizeInWords++) {
+					for (void* block : cache->blocks[sizeInWords]) owner->freeUnlocked(block);
+				}
+			}
+		}
+		delete cache;
+	}
+}
+//runs as a thread exits. holding the registry lock the whole time means the manager can't be destroyed halfway through,
+//and holding its central lock (waiting for it, unlike flushCache) means it can't be reinitialized between checking the generation
+//and handing the blocks back. nothing takes the registry lock while holding a central lock, so the order is always the same
+
+void MemoryManager::setMmapBacking(bool enabled, bool hugePages) {
+	mmapBacking = enabled;
+	hugePageBacking = enabled && hugePages;
+}
+//takes effect on the next initialize. the arena comes from an anonymous mmap instead of malloc, so pages are only
+//committed when they're first touched, and freed pages can be handed back with releaseFreePages or setPageRelease
+
+void MemoryManager::setPageRelease(size_t minimumBytes) {
+	pageReleaseBytes = minimumBytes;
+}
+//once a free leaves at least this many bytes of whole pages free that weren't before, give them back to the OS right away
+//0 turns it off. only does anything for mmap backed arenas
+
+size_t MemoryManager::releaseFreePages() {
+	auto lock = lockCentral();
+	if (!arenaMapped) return 0;
+	size_t pageSize = sysconf(_SC_PAGESIZE);
+	size_t releasedBytes = 0;
+	const std::map<size_t, size_t>& holes = currentHoles();
+	size_t keptFront = 0;
+	size_t keptBack = 0;
+	if (arenaEngine == TLSF_ENGINE && tlsfInBlock) {
+		keptFront = TLSF_IN_BLOCK_MIN_WORDS - 1;
+		keptBack = 1;
+	}
+	//a free TLSF block keeps its header and links in its first three words and its footer in its last, so those pages stay
+	for (auto iter = holes.begin(); iter != holes.end(); iter++) {
+		size_t firstByte = ((iter->first + keptFront) * bytesPerWord + pageSize - 1) / pageSize * pageSize;
+		size_t lastByte = (iter->first + iter->second - keptBack) * bytesPerWord / pageSize * pageSize;
+		if (lastByte > firstByte) {
+			madvise(static_cast<char*>(memoryStart) + firstByte, lastByte - firstByte, MADV_DONTNEED);
+			releasedBytes += lastByte - firstByte;
+		}
+	}
+	return releasedBytes;
+}
+//every page that's entirely inside a hole goes back to the OS. the address range stays ours, and the pages come back (zeroed)
+//the next time something touches them. returns how many bytes of pages that covered, whether or not they were committed
+
+void MemoryManager::releasePages(size_t holeBegin, size_t holeEnd, size_t freedBegin, size_t freedEnd) {
+	if (!arenaMapped) return;
+	if (arenaEngine == TLSF_ENGINE && tlsfInBlock) {
+		holeBegin += TLSF_IN_BLOCK_MIN_WORDS - 1;
+		holeEnd--;
+	}
+	size_t pageSize = sysconf(_SC_PAGESIZE);
+	size_t firstByte = std::max((holeBegin * bytesPerWord + pageSize - 1) / pageSize, freedBegin * bytesPerWord / pageSize) * pageSize;
+	size_t lastByte = std::min((holeEnd * bytesPerWord) / pageSize, (freedEnd * bytesPerWord + pageSize - 1) / pageSize) * pageSize;
+	if (lastByte > firstByte && lastByte - firstByte >= pageReleaseBytes) {
+		madvise(static_cast<char*>(memoryStart) + firstByte, lastByte - firstByte, MADV_DONTNEED);
+	}
+}
+//the pages that are entirely free now, but only the ones that overlap the block we just freed. the rest of the hole
+//was already free before, so if those pages were worth releasing they already were. keeps each free's cost to its own size
+//a TLSF block with its tags in the arena needs its first three words and its last one, so those pages are left out too
+
+//opens the heap in filename, or makes a new sizeInWords one there if it doesn't have one yet. 0 on success, -1 on failure
+//an existing heap keeps its own size (sizeInWords is ignored), and comes back with every block where it was
+int MemoryManager::initializeFromFile(char* filename, size_t sizeInWords) {
+	auto lock = lockCentral();
+	shutdownUnlocked();
+	int file = open(filename, O_RDWR | O_CREAT, 0644);
+	if (file == -1) return -1;
+	struct stat fileStatus;
+	if (fstat(file, &fileStatus) == -1) {
+		close(file);
+		return -1;
+	}
+	size_t fileBytes = fileStatus.st_size;
+	size_t pageSize = sysconf(_SC_PAGESIZE);
+
+	PersistentHeapHeader header;
+	bool reattach = pread(file, &header, sizeof(header), 0) == sizeof(header) && memcmp(header.magic, PERSISTENT_MAGIC, 8) == 0;
+	size_t headerBytes = (sizeof(header) + pageSize - 1) / pageSize * pageSize;
+	//the arena has to start on a page for mmap, so the header gets padded out to one
+	if (reattach) {
+		if (header.wordSize != bytesPerWord || header.dirty != 0 || header.arenaWords > arenaLimitInWords ||
+			header.headerBytes < sizeof(header) || header.headerBytes % pageSize != 0 || header.headerBytes > fileBytes) {
+			close(file);
+			return -1;
+		}
+		sizeInWords = header.arenaWords;
+		headerBytes = header.headerBytes;
+	}
+	//a dirty heap means the last process died without writing its blocks out, so the table can't be trusted. better to refuse than guess
+	//the header says where its own arena starts, since the page size it was padded to might not be ours. any multiple of ours maps fine
+	else if (sizeInWords > arenaLimitInWords) {
+		close(file);
+		return -1;
+	}
+
+	size_t arenaBytes = std::max(sizeInWords * bytesPerWord, static_cast<size_t>(1));
+	if (reattach && (fileBytes - headerBytes < arenaBytes || header.blockCount > (fileBytes - headerBytes - arenaBytes) / (2 * sizeof(uint64_t)))) {
+		close(file);
+		return -1;
+	}
+	//a file cut short would map fine and then fault on the first touch past its end, and a table that runs off the end is garbage
+	if (!reattach && ftruncate(file, headerBytes + arenaBytes) == -1) {
+		close(file);
+		return -1;
+	}
+	void* mapped = mmap(nullptr, arenaBytes, PROT_READ | PROT_WRITE, MAP_SHARED, file, headerBytes);
+	if (mapped == MAP_FAILED) {
+		close(file);
+		return -1;
+	}
+	//shared, so what we write to the arena goes straight to the file, and the next process sees it the moment it maps it
+
+	std::vector<uint64_t> table;
+	if (reattach) {
+		table.resize(header.blockCount * 2);
+		size_t tableBytes = table.size() * sizeof(uint64_t);
+		bool tableValid = tableBytes == 0 || pread(file, table.data(), tableBytes, headerBytes + arenaBytes) == static_cast<ssize_t>(tableBytes);
+		size_t lastBlockEnd = 0;
+		for (size_t i = 0; tableValid && i < table.size(); i += 2) {
+			tableValid = (i == 0 || table[i] > table[i - 2]) && table[i] >= lastBlockEnd && table[i] <= sizeInWords && table[i + 1] <= sizeInWords - table[i];
+			lastBlockEnd = table[i] + table[i + 1];
+		}
+		if (!tableValid) {
+			munmap(mapped, arenaBytes);
+			close(file);
+			return -1;
+		}
+	}
+	//every block has to be in the arena, after the one before it, and not overlapping it, or the hole map rebuilt from them would be nonsense
+
+	memoryStart = mapped;
+	memorySizeInWords = sizeInWords;
+	arenaMapped = true;
+	mappedBytes = arenaBytes;
+	heapFile = file;
+	heapFileDirty = false;
+	heapHeaderBytes = headerBytes;
+	isInitialized = true;
+	arenaGeneration++;
+	if (threadSafe) cacheClassTags.assign(sizeInWords, 0);
+	arenaEngine = HOLE_MAP_ENGINE;
+	//same as the end of initialize. persistent heaps always use the hole map, since it's the one that can be rebuilt from a block list
+
+	size_t lastBlockEnd = 0;
+	for (size_t i = 0; i < table.size(); i += 2) {
+		allocatedMemory.emplace_hint(allocatedMemory.end(), table[i], table[i + 1]);
+		if (table[i] > lastBlockEnd) addHole(lastBlockEnd, table[i] - lastBlockEnd);
+		lastBlockEnd = table[i] + table[i + 1];
+	}
+	if (lastBlockEnd < sizeInWords) addHole(lastBlockEnd, sizeInWords - lastBlockEnd);
+	//the table's in offset order, so both maps are filled from the back, and the gaps are the holes. one pass over the blocks
+	if (liveBitmapEnabled) rebuildLiveBitmap();
+
+	if (!reattach && writeHeapHeader(false) == -1) {
+		shutdownUnlocked();
+		return -1;
+	}
+	return 0;
+}
+
+//writes the block table and a clean header, and flushes the arena to disk. 0 on success, -1 on failure
+//shutdown does this by itself. calling it along the way means a crash after this point still leaves a heap that can be reopened
+int MemoryManager::syncPersistentHeap() {
+	auto lock = lockCentral();
+	return syncPersistentHeapUnlocked();
+}
+
+int MemoryManager::syncPersistentHeapUnlocked() {
+	if (heapFile == -1) return -1;
+
+	std::vector<uint64_t> table;
+	table.reserve(allocatedMemory.size() * 2);
+	for (auto iter = allocatedMemory.begin(); iter != allocatedMemory.end(); iter++) {
+		table.push_back(iter->first);
+		table.push_back(iter->second);
+	}
+	size_t tableOffset = heapHeaderBytes + mappedBytes;
+	size_t tableBytes = table.size() * sizeof(uint64_t);
+	if (ftruncate(heapFile, tableOffset + tableBytes) == -1) return -1;
+	if (tableBytes != 0 && pwrite(heapFile, table.data(), tableBytes, tableOffset) != static_cast<ssize_t>(tableBytes)) return -1;
+	if (msync(memoryStart, mappedBytes, MS_SYNC) == -1) return -1;
+	//everything the header is about to vouch for has to be down first
+
+	if (writeHeapHeader(false) == -1) return -1;
+	return fsync(heapFile);
+}
+
+void MemoryManager::markHeapDirty() {
+	if (heapFileDirty) return;
+	writeHeapHeader(true);
+}
+//the first allocate or free after a sync flags the file, so if we crash before the next one nobody trusts the old table
+
+int MemoryManager::writeHeapHeader(bool dirty) {
+	PersistentHeapHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, PERSISTENT_MAGIC, 8);
+	header.wordSize = bytesPerWord;
+	header.arenaWords = memorySizeInWords;
+	header.blockCount = allocatedMemory.size();
+	header.dirty = dirty ? 1 : 0;
+	header.headerBytes = heapHeaderBytes;
+	if (pwrite(heapFile, &header, sizeof(header), 0) != sizeof(header)) return -1;
+	heapFileDirty = dirty;
+	return 0;
+}
+
+uint64_t MemoryManager::getOffsetHandle(void* address) {
+	if (wordOffsetOf(address) < 0) return 0;
+	return static_cast<char*>(address) - static_cast<char*>(memoryStart) + 1;
+}
+//a handle is the byte offset into the arena, plus 1 so that 0 can mean no handle
+//unlike a pointer, it means the same thing wherever the arena ends up mapped, so it's what to store inside a persistent heap
+
+void* MemoryManager::resolveOffsetHandle(uint64_t handle) {
+	if (handle == 0 || handle > memorySizeInWords * bytesPerWord) return nullptr;
+	return static_cast<char*>(memoryStart) + handle - 1;
 }
 
 unsigned MemoryManager::getWordSize() {
@@ -273,11 +2290,19 @@ void* MemoryManager::getMemoryStart() {
 	return memoryStart;
 }
 
-unsigned MemoryManager::getMemoryLimit() {
+size_t MemoryManager::getMemoryLimit() {
 	return bytesPerWord * memorySizeInWords;
 }
 //total number of words times bytes in each word gives total number of bytes
 
+bool MemoryManager::isEmpty() {
+	auto lock = lockCentral();
+	if (!isInitialized) return true;
+	if (arenaEngine == TLSF_ENGINE) return (tlsfTag(0) & TLSF_FREE_TAG) && (tlsfTag(0) >> TLSF_TAG_BITS) == memorySizeInWords;
+	return allocatedMemory.empty();
+}
+//nothing allocated at all. TLSF doesn't keep allocatedMemory, but an empty TLSF arena is one free block covering everything
+
 int bestFit(int sizeInWords, void* list) {
 	int wordOffset = -1;	//initialize to return value for failure, since then we don't need any special cases (we just never change it)
 	uint16_t bestHoleSize = UINT16_MAX;	//initialize to max for uint_16 so it'll always be replaced by the first hole we find
@@ -317,3 +2342,32 @@ int worstFit(int sizeInWords, void* list) {
 
 	return wordOffset;
 }
+
+int64_t bestFitView(size_t sizeInWords, const HoleView& holes) {
+	int64_t wordOffset = -1;
+	int64_t bestHoleSize = -1;	//-1 means we haven't found one yet. unlike bestFit, this lets a hole of the max size still be picked
+
+	for (auto iter = holes.begin(); iter != holes.end(); iter++) {
+		if (iter->second >= sizeInWords && (bestHoleSize == -1 || (int64_t)iter->second < bestHoleSize)) {
+			bestHoleSize = iter->second;
+			wordOffset = iter->first;
+		}
+	}
+
+	return wordOffset;
+}
+
+int64_t worstFitView(size_t sizeInWords, const HoleView& holes) {
+	int64_t wordOffset = -1;
+	int64_t bestHoleSize = -1;
+
+	for (auto iter = holes.begin(); iter != holes.end(); iter++) {
+		if (iter->second >= sizeInWords && (int64_t)iter->second > bestHoleSize) {
+			bestHoleSize = iter->second;
+			wordOffset = iter->first;
+		}
+	}
+
+	return wordOffset;
+}
+//view versions of the two fits, as examples of the view interface. they still scan, but without the list allocation
@@ -1,9 +1,21 @@
 #pragma once
 
 #include <iostream>
+#include <cstdint>
 #include <functional>
 #include <map>
+#include <set>
+#include <vector>
+#include <algorithm>
 #include <string>
+#include <cstring>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <thread>
+#include <unordered_map>
+#include <memory>
 #include <fcntl.h>
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -11,11 +23,140 @@
 //POSIX file IO include
 
 #define SIZE_LIMIT 65535
+#define WIDE_SIZE_LIMIT 0xFFFFFFFFFFFFull
+#define HUGE_PAGE_BYTES (2 * 1024 * 1024)
+#define PERSISTENT_MAGIC "MMHEAP01"
+//SIZE_LIMIT is what fits in the 16 bit list and bitmap formats. wide offsets go up to 48 bits worth of words,
+//which is already more than any address space we could malloc out of
+
+#define TLSF_SL_BITS 4
+#define TLSF_SL_COUNT 16
+#define TLSF_FL_COUNT 48
+//TLSF size classes: the first level is the power of two a size falls under, the second splits that into 16 even slices
+//48 first levels covers every size up to WIDE_SIZE_LIMIT
+
+#define TLSF_FREE_TAG 1
+#define TLSF_PREVIOUS_FREE_TAG 2
+#define TLSF_TAG_BITS 2
+#define TLSF_NO_BLOCK ((size_t)-1)
+//boundary tags are the block size shifted up past these flag bits
+#define TLSF_IN_BLOCK_MIN_WORDS 4
+//with the tags kept in the arena, a free block needs room for its header, both list links and its footer
+
+#define THREAD_CACHE_MAX_WORDS 16
+#define THREAD_CACHE_BATCH 32
+#define THREAD_CACHE_LIMIT 128
+//thread safe mode: blocks up to THREAD_CACHE_MAX_WORDS long are cached per thread. a thread takes THREAD_CACHE_BATCH at a time
+//from the shared arena when it runs out, and gives half back once it's holding more than THREAD_CACHE_LIMIT of one size
+
+#define ALIGNED_FIT_SCAN_LIMIT 8
+//best fit aligned allocation: how many too-close-to-call holes get checked before skipping to ones certain to fit
+
+#define TELEMETRY_BUCKETS 64
+//hole size histogram: bucket n counts holes from 2^n to 2^(n+1) - 1 words long
+
+struct ThreadCache;
+struct ThreadCacheSet;
+
+struct PersistentHeapHeader {
+	char magic[8];			//PERSISTENT_MAGIC, without the null
+	uint64_t wordSize;
+	uint64_t arenaWords;
+	uint64_t blockCount;	//how many (offset, length) pairs of uint64_t are in the table after the arena
+	uint64_t dirty;			//1 while a process has changed the blocks since the table was last written
+	uint64_t headerBytes;	//where the arena starts in the file
+};
+//layout of a persistent heap file: this header, padded to the page size so the arena starts on a page,
+//then the arena itself, then the table of allocated blocks. holes aren't stored, they're just the gaps between blocks
+
+struct RemoteFreeNode {
+	void* address;
+	RemoteFreeNode* next;
+};
+//for arenas whose words are too small to hold the link themselves
+
+struct CompactionReport {
+	size_t blocksMoved;
+	size_t wordsMoved;
+	bool finished;			//reached the top of the arena. the next call starts again from the bottom
+	size_t holesBefore;
+	size_t holesAfter;
+	size_t largestHoleBefore;	//in words
+	size_t largestHoleAfter;
+	double fragmentationBefore;	//1 - largest hole / free words, so 0 when all the free space is in one hole
+	double fragmentationAfter;
+};
+
+struct MemoryTelemetry {
+	size_t arenaWords;
+	size_t freeWords;
+	size_t largestHole;		//in words. on TLSF it can come up to 1/16th short, see largestFreeBlock
+	size_t holeCount;
+	size_t holeSizeHistogram[TELEMETRY_BUCKETS];
+	double fragmentation;	//1 - largestHole / freeWords. close to 1 means lots of free space, but none of it in one piece
+	size_t allocations;		//blocks handed out by the arena
+	size_t frees;			//blocks given back to it
+	size_t failedAllocations;	//requests that came back null because nothing was big enough
+};
+//for the buddy engine, holes are its free blocks, which aren't always merged (two free blocks that aren't buddies can sit side by side)
+//in thread safe mode, blocks sitting in thread caches count as allocated, since as far as the arena knows they are
+
+struct ReallocationStats {
+	size_t inPlace;		//shrunk, grown into the hole after the block, or already the right size
+	size_t moved;		//had to allocate somewhere else, copy and free the old block
+	size_t failed;		//couldn't grow in place and nothing else was big enough. the old block is left as it was
+};
+
+enum FitStrategy {
+	CUSTOM_FIT,		//hand the hole list to allocatorFunction, like the original design
+	CUSTOM_VIEW_FIT,	//hand a read-only view of the live holes to viewAllocatorFunction, no list needed
+	CUSTOM_WIDE_FIT,	//hand the 64 bit hole list to wideAllocatorFunction
+	BEST_FIT,
+	WORST_FIT,
+	FIRST_FIT,		//lowest offset hole that fits, from an index of the holes that's only kept while this is the strategy
+	BITMAP_FIRST_FIT	//first fit by scanning the live bitmap 64 words at a time, turns the live bitmap on
+};
+//the built in strategies answer straight from the hole indexes, without making a hole list
+
+enum ArenaEngine {
+	HOLE_MAP_ENGINE,	//any sized holes in the hole map, picked by the FitStrategy. the default
+	BUDDY_ENGINE,	//power of two blocks that split in half and merge back with their buddy. ignores the FitStrategy
+	TLSF_ENGINE	//two level segregated fit: constant time allocate and free (for the pointer allocate returned). ignores the FitStrategy
+};
+//picked per arena when it's initialized. either way the arena, free and the reporting functions work the same
+
+#define TRACE_MAGIC "MMTRACE1"
+enum TraceEvent {
+	TRACE_ALLOCATE,			//thread, block id, size in bytes
+	TRACE_ALIGNED_ALLOCATE,	//thread, block id, size in bytes, alignment
+	TRACE_FREE,				//thread, block id
+	TRACE_REALLOCATE		//thread, old block id, new block id, new size in bytes
+};
+//a trace file is TRACE_MAGIC, the word size, then a record for every call in the order they happened. a record is the event
+//as one byte and then its fields, each a LEB128 varint (7 bits a byte, low bits first), so most of them are 4 or 5 bytes
+//block ids count up from 1 in the order blocks were asked for (failed ones included), threads from 0 in the order they first show up
+
+struct FirstFitIndex;
+//the first fit index (see the .cpp). it's built on GCC's policy based tree, which only the .cpp needs to know about
+
+class HoleView {
+	private:
+		const std::map<size_t, size_t>& holes;
+
+	public:
+		typedef std::map<size_t, size_t>::const_iterator iterator;
+		HoleView(const std::map<size_t, size_t>& holeMap);
+		iterator begin() const;
+		iterator end() const;
+		size_t size() const;
+};
+//what a view allocator sees: the manager's own holes in offset order, first is the offset and second the length
+//it's only valid for the length of the call, since allocating changes the holes right after
 
 class MemoryManager {
 	private:
-		std::map<uint16_t, uint16_t> allocatedMemory;	
-		std::map<uint16_t, uint16_t> holes;
+		std::map<size_t, size_t> allocatedMemory;	
+		std::map<size_t, size_t> holes;
 		//data structure to track allocated memory, and one to track the holes
 		//track allocated memory explicitly to easily solve situations where we free memory directly next to another reserved chunk
 		//while we could derive the holes from the allocated memory, the spec makes it sound like we have to track it explicity
@@ -23,29 +164,243 @@ class MemoryManager {
 
 		//the first uint is the offset, the second is the length
 
+		std::set<std::pair<size_t, size_t>> holesBySize;
+		//the same holes again, but sorted by length then offset, so the built in fits are a single lookup instead of a scan
+		//only ever changed through addHole and removeHole, which keep it matching holes
+
+		std::unique_ptr<FirstFitIndex> firstFitHoles;
+		//and again in offset order with the longest hole under each node, only while FIRST_FIT is the strategy (null otherwise).
+		//same rules as holesBySize
+
 		void* memoryStart;
 		bool isInitialized;	//redundant, but easier and clearer than checking if memoryStart is null
 		unsigned bytesPerWord;
 		size_t memorySizeInWords;	//can get total size by multiplying wordSize and size in words
+		size_t arenaLimitInWords;	//SIZE_LIMIT unless wide offsets are turned on
+		bool mmapBacking;		//these two only take effect on the next initialize, like setWideOffsets
+		bool hugePageBacking;
+		bool arenaMapped;		//whether the current arena came from mmap, so shutdown knows how to give it back
+		size_t mappedBytes;
+		size_t pageReleaseBytes;	//0 means free never gives pages back by itself
+		ReallocationStats reallocationStats;
+		size_t freeWordCount;
+		size_t freeBlockCount;
+		size_t freeBlockHistogram[TELEMETRY_BUCKETS];
+		size_t allocationCount;
+		size_t freeCount;
+		size_t failedAllocationCount;
+		//telemetry, kept up to date as we go so reading it never has to walk anything. the first three are changed
+		//only by countFreeBlock, which every engine calls from the functions that add and remove its free blocks
+
+		struct HandleSlot {
+			size_t offset;			//where the block is now
+			uint32_t generation;	//goes up every time the slot is freed, so an old handle to it stops resolving
+			bool live;
+		};
+		std::vector<HandleSlot> handleSlots;
+		std::vector<uint32_t> freeHandleSlots;
+		std::map<size_t, uint32_t> handleBlocks;	//block offset to slot, for every block allocated through a handle
+		size_t compactionCursor;	//where the compactor picks up on its next call
+		std::map<size_t, size_t> alignedBlocks;
+		//block offset to the alignment allocate(size, alignment) was asked for, for the blocks a plain allocate couldn't have lined up
+		//by chance. reallocate needs it to keep the block aligned if it has to move
+		//handle blocks are the only ones compact moves. everything allocated the normal way is pinned where it is
+		int heapFile;			//-1 unless the arena is a persistent heap file
+		bool heapFileDirty;		//whether the file's header already says so, so we only write it once per change of state
+		size_t heapHeaderBytes;	//the header and its padding, so the arena's offset in the file
 		std::function<int(int, void*)> allocatorFunction;
+		std::function<int64_t(size_t, const HoleView&)> viewAllocatorFunction;
+		std::function<int64_t(size_t, void*)> wideAllocatorFunction;
+		FitStrategy fitStrategy;
+
+		std::vector<uint64_t> liveBitmap;
+		bool liveBitmapEnabled;
+		//optional copy of the bitmap that allocate and free keep up to date, same bit order as getBitmap
+		//word n is bit n % 64 of liveBitmap[n / 64]. bits past the end of the arena stay 0
+
+		ArenaEngine arenaEngine;
+		std::map<size_t, size_t> reportedHoles;	//scratch space for currentHoles when the hole map isn't in use
+
+		std::vector<std::set<size_t>> buddyFreeLists;
+		std::vector<std::vector<uint64_t>> buddyFreeBits;
+		uint64_t buddyNonEmptyOrders;
+		//buddy engine only. list n holds the offsets of free blocks 2^n words long, lowest first
+		//bit (offset >> n) of buddyFreeBits[n] is set when that block is on list n, so checking a buddy doesn't need a lookup
+		//and bit n of buddyNonEmptyOrders is set when list n has anything in it
+
+		bool tlsfInBlock;
+		std::vector<uint64_t> tlsfTags;
+		std::vector<size_t> tlsfNext;
+		std::vector<size_t> tlsfPrev;
+		std::vector<uint64_t> tlsfStarts;
+		std::vector<size_t> tlsfHeads;
+		uint64_t tlsfFirstLevel;
+		uint32_t tlsfSecondLevel[TLSF_FL_COUNT];
+		size_t tlsfLargest;
+		bool tlsfLargestKnown;
+		//the longest free block, for as long as it's known. taking a block that long off the lists forgets it until it can be worked out again
+		//TLSF engine only. every block has a tag (size and flags) on its first word, and a free block has one on its last word too,
+		//so either neighbor of a block is one lookup away (the flag for whether the block before is free says when to look back).
+		//free blocks are on a doubly linked list per size class, tlsfHeads[first level * TLSF_SL_COUNT + second level] is the front of each list
+		//bit n of tlsfFirstLevel is set when any list at first level n has a block, and tlsfSecondLevel[n] does the same per list
+		//with words of 8 bytes or more (tlsfInBlock), the tags and links are in the arena itself, like a normal TLSF: the header word
+		//sits in front of what allocate hands out, and a free block keeps its next and previous links in the two words after its header.
+		//smaller words can't hold them, so then they sit beside the arena in tlsfTags, tlsfNext and tlsfPrev, 24 bytes per word.
+		//either way bit n % 64 of tlsfStarts[n / 64] is set when a block starts on word n, so a pointer into a block finds its header
+
+		bool threadSafe;
+		std::mutex centralLock;		//guards everything above when threadSafe is on. the thread caches don't need it
+		uint64_t managerId;			//never reused, so a thread can tell if the manager its cache belongs to is gone
+		std::atomic<uint64_t> arenaGeneration;	//goes up on every initialize and shutdown, so caches from an old arena get thrown out
+		//changed only under centralLock, like cacheClassTags and threadSafe. atomic since each thread checks it against its cache without it
+		std::vector<uint8_t> cacheClassTags;
+		//one byte per word, set on the first word of each block that belongs to the thread caches (to its length in words)
+		//lets free tell a cacheable block from anything else without the lock. only blocks that aren't in anyone's hands change it
+		friend struct ThreadCacheSet;
+
+		std::atomic<void*> remoteFrees;
+		//frees from threads that can't (or don't want to) touch the arena right now, waiting for whoever does next
+		//a stack linked through the freed blocks themselves: each one's first bytes hold the next one's address
+		//if a word is smaller than a pointer, the entries are RemoteFreeNodes from the regular heap instead
+
+		std::FILE* traceFile;		//null unless startTrace is recording
+		std::mutex traceLock;		//separate from centralLock, since the thread cache paths get traced too
+		uint64_t nextTraceId;
+		std::unordered_map<void*, uint64_t> traceIds;	//block id of every block handed out while tracing, by the address it was given as
+		std::map<std::thread::id, uint64_t> traceThreads;
+
+		void addHole(size_t offset, size_t length);
+		void removeHole(std::map<size_t, size_t>::iterator hole);
+		int64_t findHole(size_t sizeInWords);
+		std::map<size_t, size_t>::iterator findBlock(void* address);
+		void chooseStrategy(std::function<int(int, void*)>& allocator);
+		void indexFirstFit();
+		uint8_t* buildBitmap(int headerBytes);
+		static void setBitRun(uint8_t* bits, size_t begin, size_t end);
+		void markLiveBits(size_t begin, size_t end, bool allocated);
+		void rebuildLiveBitmap();
+		const std::map<size_t, size_t>& currentHoles();
+		void* addressOf(size_t wordOffset);
+		int64_t wordOffsetOf(void* address);
+		void buddySetup();
+		int64_t buddyAllocate(size_t& sizeInWords);
+		void buddyFree(size_t offset, size_t length);
+		void buddyAddFree(size_t offset, size_t order);
+		void buddyRemoveFree(size_t offset, size_t order);
+		bool buddyIsFree(size_t offset, size_t order);
+		bool tlsfSetup();
+		int64_t tlsfAllocate(size_t& sizeInWords);
+		void tlsfFree(size_t offset);
+		int64_t tlsfFindBlock(void* address);
+		void tlsfInsertFree(size_t offset, size_t length);
+		void tlsfRemoveFree(size_t offset);
+		void tlsfSetTags(size_t offset, size_t length, uint64_t flags);
+		uint64_t tlsfTag(size_t offset);
+		void tlsfWriteTag(size_t offset, uint64_t tag);
+		size_t tlsfNextFree(size_t offset);
+		size_t tlsfPrevFree(size_t offset);
+		void tlsfSetNextFree(size_t offset, size_t next);
+		void tlsfSetPrevFree(size_t offset, size_t prev);
+		size_t tlsfHeaderWords();
+		size_t tlsfMinimumBlock();
+		void tlsfMarkStart(size_t offset, bool isStart);
+		static void tlsfMapping(size_t length, size_t& firstLevel, size_t& secondLevel);
+		void* allocateUnlocked(size_t sizeInBytes);
+		void* allocateAlignedUnlocked(size_t sizeInBytes, size_t alignment);
+		int64_t alignedOffset(size_t offset, size_t alignment);
+		int64_t findAlignedHole(size_t sizeInWords, size_t alignment, size_t& holeOffset);
+		void freeUnlocked(void* address);
+		void returnToHoles(size_t memoryBegin, size_t memoryEnd);
+		bool resizeInPlace(void* address, size_t newSizeInWords);
+		int64_t handleOffset(uint64_t handle);
+		void dropHandle(size_t blockOffset);
+		void measureFragmentation(size_t& holeCount, size_t& largestHole, double& fragmentation);
+		void countFreeBlock(size_t length, bool added);
+		size_t largestFreeBlock();
+		uint16_t* buildList();
+		uint64_t* buildWideList();
+		int64_t scanFreeRun(size_t sizeInWords, size_t startWord);
+		std::unique_lock<std::mutex> lockCentral();
+		ThreadCache* threadCache();
+		void flushCache(ThreadCache* cache, size_t sizeInWords, size_t keep);
+		void pushRemoteFree(void* address);
+		void drainRemoteFrees();
+		void releasePages(size_t holeBegin, size_t holeEnd, size_t freedBegin, size_t freedEnd);
+		void markHeapDirty();
+		int writeHeapHeader(bool dirty);
+		int syncPersistentHeapUnlocked();
+		void shutdownUnlocked();
+
+		void* allocateBlock(size_t sizeInBytes);
+		void* allocateAlignedBlock(size_t sizeInBytes, size_t alignment);
+		void* reallocateBlock(void* address, size_t newSizeInBytes);
+		void traceAllocate(void* address, size_t sizeInBytes, size_t alignment);
+		void traceFree(void* address, bool findStart);
+		uint64_t traceReallocate(void* address, size_t newSizeInBytes, uint64_t& newId);
+		void traceResult(void* address, uint64_t blockId);
+		void writeTraceRecord(uint8_t event, std::initializer_list<uint64_t> fields);
+		uint64_t traceThread();
+		static size_t encodeVarint(uint64_t value, uint8_t* bytes);
 
 	public:
 		MemoryManager(unsigned wordSize, std::function<int(int, void*)> allocator);
+		MemoryManager(unsigned wordSize, FitStrategy strategy);
 		~MemoryManager();
-		void initialize(size_t sizeInWords);
+		void initialize(size_t sizeInWords, ArenaEngine engine = HOLE_MAP_ENGINE);
 		void shutdown();
 		void* allocate(size_t sizeInBytes);
+		void* allocate(size_t sizeInBytes, size_t alignment);
 		void free(void* address);
+		void* reallocate(void* address, size_t newSizeInBytes);
+		ReallocationStats getReallocationStats();
+		uint64_t allocateHandle(size_t sizeInBytes);
+		void* resolveHandle(uint64_t handle);
+		void freeHandle(uint64_t handle);
+		CompactionReport compact(size_t budgetMicroseconds = 0);
+		MemoryTelemetry getTelemetry();
+		std::string getTelemetryJson();
+		int startTrace(char* filename);
+		int stopTrace();
+		void* getAllocationStart(void* address);
+		size_t getAllocationSize(void* address);
 		void setAllocator(std::function<int(int, void*)> allocator);
+		void setViewAllocator(std::function<int64_t(size_t, const HoleView&)> allocator);
+		void setWideAllocator(std::function<int64_t(size_t, void*)> allocator);
+		void setWideOffsets(bool wide);
+		void setFitStrategy(FitStrategy strategy);
+		FitStrategy getFitStrategy();
+		ArenaEngine getArenaEngine();
+		static size_t minimumArenaWords(size_t sizeInBytes, unsigned wordSize, ArenaEngine engine);
 		int dumpMemoryMap(char* filename);
 		void* getList();
+		void* getWideList();
 		void* getBitmap();
+		void* getWideBitmap();
 		unsigned getWordSize();
 		void* getMemoryStart();
-		unsigned getMemoryLimit();
+		size_t getMemoryLimit();
+		bool isEmpty();
+		void setLiveBitmap(bool enabled);
+		const uint8_t* getLiveBitmap();
+		size_t getLiveBitmapSize();
+		int64_t findFreeRun(size_t sizeInWords, size_t startWord = 0);
+		size_t countFreeWords(size_t beginWord, size_t endWord);
+		void setThreadSafe(bool enabled);
+		bool isThreadSafe();
+		void flushThreadCache();
+		void freeRemote(void* address);
+		void setMmapBacking(bool enabled, bool hugePages = false);
+		void setPageRelease(size_t minimumBytes);
+		size_t releaseFreePages();
+		int initializeFromFile(char* filename, size_t sizeInWords);
+		int syncPersistentHeap();
+		uint64_t getOffsetHandle(void* address);
+		void* resolveOffsetHandle(uint64_t handle);
 };
 
 int bestFit(int sizeInWords, void* list);
 int worstFit(int sizeInWords, void* list);
+int64_t bestFitView(size_t sizeInWords, const HoleView& holes);
+int64_t worstFitView(size_t sizeInWords, const HoleView& holes);
 
 //alocator functions, declared outside of class
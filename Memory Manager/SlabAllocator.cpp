@@ -0,0 +1,200 @@
+#include "SlabAllocator.h"
+
+SlabAllocator::SlabAllocator(MemoryManager& manager, size_t slabBytes) : memoryManager(manager) {
+	slabSizeInBytes = 1;
+	while (slabSizeInBytes < slabBytes) slabSizeInBytes *= 2;
+	//a power of two, so a slab can be aligned to its own size
+	slabsCreated = 0;
+	slabsReleased = 0;
+	passThroughAllocations = 0;
+}
+
+SlabAllocator::~SlabAllocator() {
+	for (auto iter = slabsByAddress.begin(); iter != slabsByAddress.end(); iter++) {
+		memoryManager.free(iter->second->start);
+		delete iter->second;
+	}
+	//give every slab back, whether or not there's still something in it. pass through allocations are left to the caller
+}
+
+int SlabAllocator::addSizeClass(size_t objectSizeInBytes) {
+	size_t wordSize = memoryManager.getWordSize();
+	size_t objectSize = std::max(objectSizeInBytes, sizeof(void*));
+	if (objectSize % wordSize != 0) objectSize += wordSize - objectSize % wordSize;
+	//a free object has to hold the free list link, and objects stay lined up on words like the manager's own allocations
+
+	if (objectSize > slabSizeInBytes) return -1;	//not even one would fit in a slab
+	for (size_t i = 0; i < sizeClasses.size(); i++) {
+		if (sizeClasses[i].objectSize == objectSize) return static_cast<int>(i);
+	}
+	if (!slabsByAddress.empty()) return -1;
+	//adding a class shifts the indexes the existing slabs point at, so classes have to be set up before anything is allocated
+
+	SizeClass newClass;
+	newClass.objectSize = objectSize;
+	newClass.objectsPerSlab = slabSizeInBytes / objectSize;
+	newClass.slabs = 0;
+	newClass.liveObjects = 0;
+	newClass.partialSlabs = nullptr;
+	newClass.emptySlab = nullptr;
+
+	auto position = sizeClasses.begin();
+	while (position != sizeClasses.end() && position->objectSize < objectSize) position++;
+	auto inserted = sizeClasses.insert(position, newClass);
+	return static_cast<int>(inserted - sizeClasses.begin());
+	//begin() only after the insert, since the insert can move the whole vector
+}
+
+void* SlabAllocator::allocate(size_t sizeInBytes) {
+	size_t sizeClass = 0;
+	while (sizeClass < sizeClasses.size() && sizeClasses[sizeClass].objectSize < sizeInBytes) sizeClass++;
+	if (sizeClass == sizeClasses.size()) {
+		passThroughAllocations++;
+		return memoryManager.allocate(sizeInBytes);
+	}
+	//smallest class it fits in. there's only ever a handful of classes, so a walk is as fast as anything
+
+	SizeClass& objectClass = sizeClasses[sizeClass];
+	Slab* slab = objectClass.partialSlabs;
+	if (slab == nullptr) {
+		slab = objectClass.emptySlab;
+		objectClass.emptySlab = nullptr;
+		if (slab == nullptr) slab = createSlab(sizeClass);
+		if (slab == nullptr) return nullptr;	//the manager is out of room for another slab
+		pushPartial(slab);
+	}
+
+	void* object;
+	if (slab->freeList != nullptr) {
+		object = slab->freeList;
+		memcpy(&slab->freeList, object, sizeof(void*));
+	}
+	else object = slab->start + slab->carvedObjects++ * objectClass.objectSize;
+	//reuse freed objects first, otherwise take the next never used one. either way it's constant time,
+	//and a new slab doesn't have to thread a free list through every object up front
+	//memcpy since with small words the object isn't necessarily lined up for a pointer
+
+	slab->liveObjects++;
+	objectClass.liveObjects++;
+	if (slab->liveObjects == objectClass.objectsPerSlab) removePartial(slab);	//full, so stop allocating from it
+	return object;
+}
+
+void SlabAllocator::free(void* address) {
+	Slab* slab = findSlab(address);
+	if (slab == nullptr) {
+		memoryManager.free(address);
+		return;
+	}
+	//not one of ours, so it must have been a pass through
+
+	SizeClass& objectClass = sizeClasses[slab->sizeClass];
+	size_t objectIndex = (static_cast<char*>(address) - slab->start) / objectClass.objectSize;
+	char* object = slab->start + objectIndex * objectClass.objectSize;
+	//like the manager, a pointer anywhere inside the object frees it
+
+	memcpy(object, &slab->freeList, sizeof(void*));
+	slab->freeList = object;
+	slab->liveObjects--;
+	objectClass.liveObjects--;
+	//no check for double frees, same as free() on a regular heap
+
+	if (!slab->onPartialList) pushPartial(slab);	//was full, now it has room again
+	if (slab->liveObjects == 0) {
+		removePartial(slab);
+		if (objectClass.emptySlab == nullptr) objectClass.emptySlab = slab;
+		else releaseSlab(slab);
+	}
+	//an empty slab goes back to the manager as soon as we already have a spare for that class
+}
+
+void SlabAllocator::releaseEmptySlabs() {
+	for (size_t i = 0; i < sizeClasses.size(); i++) {
+		if (sizeClasses[i].emptySlab != nullptr) {
+			releaseSlab(sizeClasses[i].emptySlab);
+			sizeClasses[i].emptySlab = nullptr;
+		}
+	}
+}
+//hands back the spares too, for when the arena is needed for something else
+
+Slab* SlabAllocator::findSlab(void* address) {
+	char* slabStart = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(address) & ~static_cast<uintptr_t>(slabSizeInBytes - 1));
+	auto slab = slabsByAddress.find(slabStart);
+	if (slab == slabsByAddress.end()) return nullptr;
+	return slab->second;
+}
+//every slab starts on a multiple of its size, so the address rounded down to one is the start of the slab it's in, if it's in one
+
+Slab* SlabAllocator::createSlab(size_t sizeClass) {
+	char* start = static_cast<char*>(memoryManager.allocate(slabSizeInBytes, slabSizeInBytes));
+	if (start == nullptr) return nullptr;
+
+	Slab* slab = new Slab();
+	slab->start = start;
+	slab->sizeClass = sizeClass;
+	slab->liveObjects = 0;
+	slab->carvedObjects = 0;
+	slab->freeList = nullptr;
+	slab->previousPartial = nullptr;
+	slab->nextPartial = nullptr;
+	slab->onPartialList = false;
+
+	slabsByAddress[start] = slab;
+	sizeClasses[sizeClass].slabs++;
+	slabsCreated++;
+	return slab;
+}
+
+void SlabAllocator::releaseSlab(Slab* slab) {
+	memoryManager.free(slab->start);	//the manager merges it back into its holes like any other block
+	slabsByAddress.erase(slab->start);
+	sizeClasses[slab->sizeClass].slabs--;
+	slabsReleased++;
+	delete slab;
+}
+
+void SlabAllocator::pushPartial(Slab* slab) {
+	SizeClass& objectClass = sizeClasses[slab->sizeClass];
+	slab->previousPartial = nullptr;
+	slab->nextPartial = objectClass.partialSlabs;
+	if (objectClass.partialSlabs != nullptr) objectClass.partialSlabs->previousPartial = slab;
+	objectClass.partialSlabs = slab;
+	slab->onPartialList = true;
+}
+
+void SlabAllocator::removePartial(Slab* slab) {
+	if (!slab->onPartialList) return;
+	SizeClass& objectClass = sizeClasses[slab->sizeClass];
+	if (slab->previousPartial != nullptr) slab->previousPartial->nextPartial = slab->nextPartial;
+	else objectClass.partialSlabs = slab->nextPartial;
+	if (slab->nextPartial != nullptr) slab->nextPartial->previousPartial = slab->previousPartial;
+	slab->previousPartial = nullptr;
+	slab->nextPartial = nullptr;
+	slab->onPartialList = false;
+}
+//partial lists are doubly linked so a slab can leave from the middle when it fills up or empties
+
+SlabStats SlabAllocator::getStats() {
+	SlabStats stats;
+	stats.slabBytes = slabsByAddress.size() * slabSizeInBytes;
+	stats.liveBytes = 0;
+	stats.slabsCreated = slabsCreated;
+	stats.slabsReleased = slabsReleased;
+	stats.passThroughAllocations = passThroughAllocations;
+
+	for (size_t i = 0; i < sizeClasses.size(); i++) {
+		SlabClassStats classStats;
+		classStats.objectSize = sizeClasses[i].objectSize;
+		classStats.objectsPerSlab = sizeClasses[i].objectsPerSlab;
+		classStats.slabs = sizeClasses[i].slabs;
+		classStats.liveObjects = sizeClasses[i].liveObjects;
+		classStats.capacity = classStats.slabs * classStats.objectsPerSlab;
+		classStats.utilization = classStats.capacity == 0 ? 0 : static_cast<double>(classStats.liveObjects) / classStats.capacity;
+		stats.liveBytes += classStats.liveObjects * classStats.objectSize;
+		stats.classes.push_back(classStats);
+	}
+	stats.utilization = stats.slabBytes == 0 ? 0 : static_cast<double>(stats.liveBytes) / stats.slabBytes;
+	return stats;
+}
+//everything here is kept as we go, so this is just copying out one entry per class
@@ -0,0 +1,76 @@
+#pragma once
+
+#include "MemoryManager.h"
+
+#define DEFAULT_SLAB_BYTES 4096
+
+struct Slab {
+	char* start;
+	size_t sizeClass;		//index into the allocator's size classes
+	size_t liveObjects;
+	size_t carvedObjects;	//objects handed out at least once. past this point the slab is untouched, so no free list needed
+	void* freeList;		//most recently freed object first. each free object holds the address of the next one in its first bytes
+	Slab* previousPartial;
+	Slab* nextPartial;
+	bool onPartialList;
+};
+//bookkeeping for one slab. kept on the regular heap, not in the arena, so the slab's memory is all objects
+
+struct SlabClassStats {
+	size_t objectSize;		//in bytes, after rounding up
+	size_t objectsPerSlab;
+	size_t slabs;
+	size_t liveObjects;
+	size_t capacity;		//slabs * objectsPerSlab
+	double utilization;		//liveObjects / capacity, 0 if there are no slabs
+};
+
+struct SlabStats {
+	std::vector<SlabClassStats> classes;
+	size_t slabBytes;		//arena bytes currently held in slabs
+	size_t liveBytes;		//bytes of live objects inside those slabs
+	size_t slabsCreated;
+	size_t slabsReleased;	//empty slabs handed back to the manager
+	size_t passThroughAllocations;	//requests too big for any class, sent straight to the manager
+	double utilization;		//liveBytes / slabBytes
+};
+
+class SlabAllocator {
+	private:
+		struct SizeClass {
+			size_t objectSize;
+			size_t objectsPerSlab;
+			size_t slabs;
+			size_t liveObjects;
+			Slab* partialSlabs;		//slabs with at least one free object, the one we allocate from is always the front
+			Slab* emptySlab;		//one empty slab kept back per class, so a single object going back and forth doesn't churn the manager
+		};
+
+		MemoryManager& memoryManager;
+		size_t slabSizeInBytes;
+		std::vector<SizeClass> sizeClasses;		//sorted by object size
+		std::unordered_map<char*, Slab*> slabsByAddress;	//by start. slabs are aligned to their size, so any address masks down to its slab's start
+		size_t slabsCreated;
+		size_t slabsReleased;
+		size_t passThroughAllocations;
+
+		Slab* findSlab(void* address);
+		Slab* createSlab(size_t sizeClass);
+		void releaseSlab(Slab* slab);
+		void pushPartial(Slab* slab);
+		void removePartial(Slab* slab);
+
+	public:
+		SlabAllocator(MemoryManager& manager, size_t slabBytes = DEFAULT_SLAB_BYTES);
+		~SlabAllocator();
+		int addSizeClass(size_t objectSizeInBytes);
+		void* allocate(size_t sizeInBytes);
+		void free(void* address);
+		void releaseEmptySlabs();
+		SlabStats getStats();
+};
+//serves small fixed size objects out of slabs it allocates from a MemoryManager, so each object costs a pointer pop instead of
+//a trip through the hole map and its own allocatedMemory entry. anything bigger than the largest size class goes straight to the manager
+//the manager's arena has to outlive the allocator, and shouldn't be shutdown or reinitialized underneath it
+//slabs are a power of two long (slabBytes is rounded up to one) and allocated aligned to their own size, so free finds an object's
+//slab by masking off the low bits of its address and one hash lookup, however many slabs there are
@@ -0,0 +1,316 @@
+#include "MemoryManager.h"
+#include <chrono>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#include <random>
+#include <thread>
+#include <memory>
+#include <cstdlib>
+
+//records allocation traces and replays them against every strategy and engine the manager has, and against malloc
+//	traceReplay record <file>				runs a mixed workload on four threads with tracing on, and saves the trace
+//	traceReplay replay <file> [arena words]	replays a trace on each target. the arena defaults to twice the trace's peak live bytes
+//a trace can come from anything that uses a MemoryManager: call startTrace on it, run it, then stopTrace
+//replays are single threaded and in the order the trace recorded, so frees of another thread's blocks land where they happened
+
+typedef std::chrono::steady_clock benchClock;
+
+struct TraceRecord {
+	uint8_t event;
+	uint64_t thread;
+	uint64_t blockId;		//the old block for a reallocate
+	uint64_t newId;			//reallocate only
+	uint64_t size;
+	uint64_t alignment;		//aligned allocate only
+};
+
+struct ReplayTarget {
+	const char* name;
+	FitStrategy strategy;
+	ArenaEngine engine;
+	bool systemMalloc;		//malloc and free instead of a manager, for comparison
+};
+
+struct ReplayResult {
+	double operationsPerSecond;
+	std::vector<double> nanoseconds;	//per operation, only filled in by the timed pass
+	double peakFragmentation;
+	size_t allocations;		//allocates and reallocates tried
+	size_t failures;
+};
+
+int recordTrace(char* filename);
+int replayTrace(char* filename, size_t arenaWords);
+
+//helpers
+bool readTrace(char* filename, unsigned& wordSize, std::vector<TraceRecord>& records);
+bool readVarint(std::FILE* file, uint64_t& value);
+size_t peakLiveBytes(std::vector<TraceRecord>& records, uint64_t& maxBlockId, uint64_t& threads);
+ReplayResult replay(ReplayTarget& target, std::vector<TraceRecord>& records, unsigned wordSize, size_t arenaWords, uint64_t maxBlockId, bool timeEach);
+double percentile(std::vector<double>& sorted, double fraction);
+
+int main(int argc, char** argv) {
+	if (argc >= 3 && strcmp(argv[1], "record") == 0) return recordTrace(argv[2]);
+	if (argc >= 3 && strcmp(argv[1], "replay") == 0) return replayTrace(argv[2], argc >= 4 ? strtoull(argv[3], nullptr, 10) : 0);
+	std::cout << "usage: traceReplay record <trace file>" << std::endl;
+	std::cout << "       traceReplay replay <trace file> [arena words]" << std::endl;
+	return 1;
+}
+
+//four threads on one thread safe manager: lots of short lived small blocks, some medium ones that stay around longer,
+//a few large ones, the occasional reallocate and aligned allocate, and some blocks freed by a different thread than allocated them
+int recordTrace(char* filename) {
+	MemoryManager memoryManager(8, BEST_FIT);
+	memoryManager.setThreadSafe(true);
+	memoryManager.setWideOffsets(true);
+	memoryManager.initialize(8 * 1024 * 1024);
+	if (memoryManager.startTrace(filename) != 0) {
+		std::cout << "couldn't open " << filename << std::endl;
+		return 1;
+	}
+
+	std::mutex exchangeLock;
+	std::vector<void*> exchange;
+	std::vector<std::thread> threads;
+	for (int t = 0; t < 4; t++) {
+		threads.emplace_back([&, t]() {
+			std::mt19937 random(t + 1);
+			std::vector<void*> shortLived;
+			std::vector<void*> longLived;
+			for (int i = 0; i < 50000; i++) {
+				unsigned kind = random() % 100;
+				if (kind < 60) {
+					shortLived.push_back(memoryManager.allocate(random() % 121 + 8));
+					if (shortLived.size() > 32) {
+						size_t index = random() % shortLived.size();
+						memoryManager.free(shortLived[index]);
+						shortLived[index] = shortLived.back();
+						shortLived.pop_back();
+					}
+				}
+				else if (kind < 85) {
+					longLived.push_back(memoryManager.allocate(random() % 3841 + 256));
+					if (longLived.size() > 400) {
+						size_t index = random() % longLived.size();
+						if (random() % 5 == 0) {
+							std::lock_guard<std::mutex> lock(exchangeLock);
+							exchange.push_back(longLived[index]);
+						}
+						else memoryManager.free(longLived[index]);
+						longLived[index] = longLived.back();
+						longLived.pop_back();
+					}
+				}
+				//a fifth of the long lived blocks get left for some other thread to free
+				else if (kind < 87) {
+					void* block = memoryManager.allocate(random() % 49153 + 16384);
+					if (block != nullptr) memoryManager.free(block);
+				}
+				else if (kind < 95 && !longLived.empty()) {
+					size_t index = random() % longLived.size();
+					void* grown = memoryManager.reallocate(longLived[index], memoryManager.getAllocationSize(longLived[index]) + random() % 512 + 1);
+					if (grown != nullptr) longLived[index] = grown;
+				}
+				else shortLived.push_back(memoryManager.allocate(random() % 256 + 1, 64));
+
+				if (i % 200 == 0) {
+					std::lock_guard<std::mutex> lock(exchangeLock);
+					for (void* block : exchange) memoryManager.free(block);
+					exchange.clear();
+				}
+			}
+			for (void* block : shortLived) memoryManager.free(block);
+			for (void* block : longLived) memoryManager.free(block);
+		});
+	}
+	for (std::thread& thread : threads) thread.join();
+	for (void* block : exchange) memoryManager.free(block);
+	memoryManager.stopTrace();
+
+	unsigned wordSize;
+	std::vector<TraceRecord> records;
+	if (!readTrace(filename, wordSize, records)) return 1;
+	struct stat fileInfo;
+	stat(filename, &fileInfo);
+	std::cout << "recorded " << records.size() << " calls to " << filename << ", " << fileInfo.st_size << " bytes ("
+		<< std::fixed << std::setprecision(1) << static_cast<double>(fileInfo.st_size) / records.size() << " per call)" << std::endl;
+	return 0;
+}
+
+int replayTrace(char* filename, size_t arenaWords) {
+	unsigned wordSize;
+	std::vector<TraceRecord> records;
+	if (!readTrace(filename, wordSize, records)) return 1;
+	uint64_t maxBlockId;
+	uint64_t threads;
+	size_t peakBytes = peakLiveBytes(records, maxBlockId, threads);
+	if (arenaWords == 0) arenaWords = std::max(peakBytes * 2 / wordSize, static_cast<size_t>(1024));
+
+	std::cout << "Replay: " << records.size() << " calls from " << threads << " threads, peak " << peakBytes / 1024 << "KB live, "
+		<< arenaWords << " word arena (" << wordSize << " byte words)" << std::endl;
+	std::cout << std::setw(18) << "" << std::setw(14) << "calls/second" << std::setw(10) << "p50 ns" << std::setw(10) << "p99 ns"
+		<< std::setw(12) << "p99.9 ns" << std::setw(12) << "max ns" << std::setw(16) << "peak fragment." << std::setw(10) << "failed" << std::endl;
+
+	ReplayTarget targets[] = {
+		{"best fit", BEST_FIT, HOLE_MAP_ENGINE, false},
+		{"worst fit", WORST_FIT, HOLE_MAP_ENGINE, false},
+		{"first fit", FIRST_FIT, HOLE_MAP_ENGINE, false},
+		{"bitmap first fit", BITMAP_FIRST_FIT, HOLE_MAP_ENGINE, false},
+		{"buddy", BEST_FIT, BUDDY_ENGINE, false},
+		{"TLSF", BEST_FIT, TLSF_ENGINE, false},
+		{"system malloc", BEST_FIT, HOLE_MAP_ENGINE, true}
+	};
+	for (ReplayTarget& target : targets) {
+		ReplayResult throughput = replay(target, records, wordSize, arenaWords, maxBlockId, false);
+		ReplayResult timed = replay(target, records, wordSize, arenaWords, maxBlockId, true);
+		//throughput from a pass with no timing in the loop, percentiles and fragmentation from a second pass that times every call
+		std::sort(timed.nanoseconds.begin(), timed.nanoseconds.end());
+
+		std::cout << std::setw(18) << target.name << std::fixed << std::setprecision(0) << std::setw(14) << throughput.operationsPerSecond
+			<< std::setw(10) << percentile(timed.nanoseconds, 0.5) << std::setw(10) << percentile(timed.nanoseconds, 0.99)
+			<< std::setw(12) << percentile(timed.nanoseconds, 0.999) << std::setw(12) << timed.nanoseconds.back();
+		if (target.systemMalloc) std::cout << std::setw(16) << "-";
+		else std::cout << std::setw(16) << std::setprecision(3) << timed.peakFragmentation;
+		std::cout << std::setw(9) << std::setprecision(2) << 100.0 * throughput.failures / std::max(throughput.allocations, static_cast<size_t>(1)) << "%" << std::endl;
+	}
+	std::cout << "(peak fragmentation is the highest 1 - largest hole / free words seen after any call. failed is out of allocates and reallocates)" << std::endl;
+	return 0;
+}
+
+bool readTrace(char* filename, unsigned& wordSize, std::vector<TraceRecord>& records) {
+	std::FILE* file = std::fopen(filename, "rb");
+	if (file == nullptr) {
+		std::cout << "couldn't open " << filename << std::endl;
+		return false;
+	}
+	char magic[8];
+	uint64_t wordSizeField;
+	if (std::fread(magic, 1, 8, file) != 8 || memcmp(magic, TRACE_MAGIC, 8) != 0 || !readVarint(file, wordSizeField)) {
+		std::cout << filename << " isn't a trace" << std::endl;
+		std::fclose(file);
+		return false;
+	}
+	wordSize = static_cast<unsigned>(wordSizeField);
+
+	int event;
+	while ((event = std::fgetc(file)) != EOF) {
+		TraceRecord record = TraceRecord();
+		record.event = static_cast<uint8_t>(event);
+		bool complete = readVarint(file, record.thread) && readVarint(file, record.blockId);
+		if (event == TRACE_ALLOCATE || event == TRACE_ALIGNED_ALLOCATE) complete = complete && readVarint(file, record.size);
+		if (event == TRACE_ALIGNED_ALLOCATE) complete = complete && readVarint(file, record.alignment);
+		if (event == TRACE_REALLOCATE) complete = complete && readVarint(file, record.newId) && readVarint(file, record.size);
+		if (!complete || event > TRACE_REALLOCATE) break;
+		//a trace cut off partway through a record (the program crashed, say) still replays up to there
+		records.push_back(record);
+	}
+	std::fclose(file);
+	return true;
+}
+
+bool readVarint(std::FILE* file, uint64_t& value) {
+	value = 0;
+	for (int shift = 0; shift < 64; shift += 7) {
+		int byte = std::fgetc(file);
+		if (byte == EOF) return false;
+		value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+		if (!(byte & 0x80)) return true;
+	}
+	return false;
+}
+
+//the most bytes asked for and not yet freed at any point, plus the biggest block id and how many threads there were
+size_t peakLiveBytes(std::vector<TraceRecord>& records, uint64_t& maxBlockId, uint64_t& threads) {
+	maxBlockId = 0;
+	threads = 0;
+	for (TraceRecord& record : records) {
+		maxBlockId = std::max(maxBlockId, std::max(record.blockId, record.newId));
+		threads = std::max(threads, record.thread + 1);
+	}
+
+	std::vector<uint64_t> sizes(maxBlockId + 1, 0);
+	size_t liveBytes = 0;
+	size_t peakBytes = 0;
+	for (TraceRecord& record : records) {
+		if (record.event == TRACE_ALLOCATE || record.event == TRACE_ALIGNED_ALLOCATE) sizes[record.blockId] = record.size;
+		else if (record.event == TRACE_REALLOCATE) sizes[record.newId] = record.size;
+		liveBytes += record.event == TRACE_FREE ? 0 : record.event == TRACE_REALLOCATE ? sizes[record.newId] : sizes[record.blockId];
+		if (record.event == TRACE_FREE || record.event == TRACE_REALLOCATE) {
+			liveBytes -= sizes[record.blockId];
+			sizes[record.blockId] = 0;
+		}
+		peakBytes = std::max(peakBytes, liveBytes);
+	}
+	return peakBytes;
+}
+
+ReplayResult replay(ReplayTarget& target, std::vector<TraceRecord>& records, unsigned wordSize, size_t arenaWords, uint64_t maxBlockId, bool timeEach) {
+	std::unique_ptr<MemoryManager> memoryManager;
+	if (!target.systemMalloc) {
+		memoryManager.reset(new MemoryManager(wordSize, target.strategy));
+		if (arenaWords > SIZE_LIMIT) memoryManager->setWideOffsets(true);
+		memoryManager->initialize(arenaWords, target.engine);
+	}
+	MemoryManager* manager = memoryManager.get();
+
+	ReplayResult result = ReplayResult();
+	if (timeEach) result.nanoseconds.reserve(records.size());
+	std::vector<void*> blocks(maxBlockId + 1, nullptr);
+	//by block id. a block whose allocation failed here stays null, and its free is skipped
+
+	auto start = benchClock::now();
+	for (TraceRecord& record : records) {
+		auto callStart = timeEach ? benchClock::now() : start;
+		void* block = nullptr;
+		switch (record.event) {
+			case TRACE_ALLOCATE:
+				block = manager != nullptr ? manager->allocate(record.size) : malloc(record.size);
+				blocks[record.blockId] = block;
+				break;
+			case TRACE_ALIGNED_ALLOCATE:
+				if (manager != nullptr) block = manager->allocate(record.size, record.alignment);
+				else if (posix_memalign(&block, std::max(record.alignment, static_cast<uint64_t>(sizeof(void*))), record.size) != 0) block = nullptr;
+				blocks[record.blockId] = block;
+				break;
+			case TRACE_FREE:
+				if (blocks[record.blockId] != nullptr) {
+					if (manager != nullptr) manager->free(blocks[record.blockId]);
+					else std::free(blocks[record.blockId]);
+					blocks[record.blockId] = nullptr;
+				}
+				break;
+			case TRACE_REALLOCATE:
+				if (manager != nullptr) block = manager->reallocate(blocks[record.blockId], record.size);
+				else block = realloc(blocks[record.blockId], record.size);
+				if (block != nullptr) blocks[record.blockId] = nullptr;
+				blocks[record.newId] = block;
+				break;
+				//a null old block (its allocation failed earlier in this replay) makes it a plain allocate, for both
+		}
+		if (record.event != TRACE_FREE) {
+			result.allocations++;
+			if (block == nullptr) result.failures++;
+		}
+
+		if (timeEach) {
+			result.nanoseconds.push_back(std::chrono::duration<double, std::nano>(benchClock::now() - callStart).count());
+			if (manager != nullptr) result.peakFragmentation = std::max(result.peakFragmentation, manager->getTelemetry().fragmentation);
+		}
+	}
+	double seconds = std::chrono::duration<double>(benchClock::now() - start).count();
+	result.operationsPerSecond = records.size() / seconds;
+
+	for (void* block : blocks) {
+		if (block == nullptr) continue;
+		if (manager != nullptr) manager->free(block);
+		else std::free(block);
+	}
+	//anything the trace never freed (it stopped early, or the program leaked)
+	return result;
+}
+
+double percentile(std::vector<double>& sorted, double fraction) {
+	if (sorted.empty()) return 0;
+	return sorted[std::min(static_cast<size_t>(fraction * sorted.size()), sorted.size() - 1)];
+}
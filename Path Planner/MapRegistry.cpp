@@ -0,0 +1,107 @@
+#include "MapRegistry.h"
+
+using ufl_cap4053::TileMap;
+using std::shared_ptr;
+using std::string;
+
+namespace ufl_cap4053
+{
+	namespace searches
+	{
+		MapRegistry::MapRegistry() {}
+
+		MapRegistry::~MapRegistry() {
+			std::unordered_map<string, std::shared_future<shared_ptr<LoadedMap>>> pending;
+			{
+				std::lock_guard<std::mutex> guard(mapsLock);
+				pending.swap(maps);
+			}
+			for (auto iter = pending.begin(); iter != pending.end(); iter++) {
+				iter->second.wait();
+			}
+		}
+		//let any loads still running finish before the table goes away. take the futures out first and wait without the lock,
+		//the same as unloadMap. graphs that searches are still using stay alive through their own references
+
+		bool MapRegistry::loadAsync(const string& key, std::function<shared_ptr<TileMap>()> loader) {
+			std::lock_guard<std::mutex> guard(mapsLock);
+			if (maps.find(key) != maps.end()) return false;	//already loaded or loading, so the cached one gets used
+
+			maps[key] = std::async(std::launch::async, [loader]() {
+				shared_ptr<LoadedMap> loaded;
+				shared_ptr<TileMap> tileMap = loader();
+				if (!tileMap) return loaded;	//loader couldn't make the map, so the key stays empty
+				loaded = std::make_shared<LoadedMap>();
+				loaded->tileMap = tileMap;
+				loaded->graph.reset(new PathSearch::SearchGraph(tileMap.get()));
+				return loaded;
+			}).share();
+			//reading the map and building its graph both happen on the worker thread
+			return true;
+		}
+
+		shared_ptr<MapRegistry::LoadedMap> MapRegistry::findLoaded(const string& key) const {
+			std::shared_future<shared_ptr<LoadedMap>> pending;
+			{
+				std::lock_guard<std::mutex> guard(mapsLock);
+				auto iter = maps.find(key);
+				if (iter == maps.end()) return nullptr;
+				pending = iter->second;
+			}
+			//copy the future out so we can wait on it without holding the lock
+			return pending.get();
+		}
+
+		bool MapRegistry::isLoaded(const string& key) const {
+			std::lock_guard<std::mutex> guard(mapsLock);
+			auto iter = maps.find(key);
+			if (iter == maps.end()) return false;
+			return iter->second.wait_for(std::chrono::seconds(0)) == std::future_status::ready && iter->second.get() != nullptr;
+		}
+
+		bool MapRegistry::waitForMap(const string& key) const {
+			return findLoaded(key) != nullptr;
+		}
+
+		shared_ptr<PathSearch::SearchGraph> MapRegistry::acquireGraph(const string& key) const {
+			shared_ptr<LoadedMap> loaded = findLoaded(key);
+			if (!loaded) return nullptr;
+			loaded->users++;
+			return shared_ptr<PathSearch::SearchGraph>(loaded->graph.get(), [loaded](PathSearch::SearchGraph*) { loaded->users--; });
+		}
+		//the deleter holds on to the whole loaded map, so the tiles can't be freed out from under the graph while it's out.
+		//it also counts the graph back in once the last copy of the returned pointer is gone
+
+		std::unique_ptr<PathSearch> MapRegistry::createSearch(const string& key) const {
+			shared_ptr<PathSearch::SearchGraph> graph = acquireGraph(key);
+			if (!graph) return nullptr;
+			std::unique_ptr<PathSearch> search(new PathSearch());
+			search->load(graph);
+			return search;
+		}
+		//blocks until the map is loaded. the search starts out not drawing, since every search on the map shares its tiles
+
+		long MapRegistry::useCount(const string& key) const {
+			std::lock_guard<std::mutex> guard(mapsLock);
+			auto iter = maps.find(key);
+			if (iter == maps.end() || iter->second.wait_for(std::chrono::seconds(0)) != std::future_status::ready) return 0;
+			shared_ptr<LoadedMap> loaded = iter->second.get();
+			if (!loaded) return 0;
+			return loaded->users.load();
+		}
+		//number of graphs handed out that are still alive. copies of one count once, since it's counted back in when the last one goes
+
+		void MapRegistry::unloadMap(const string& key) {
+			std::shared_future<shared_ptr<LoadedMap>> pending;
+			{
+				std::lock_guard<std::mutex> guard(mapsLock);
+				auto iter = maps.find(key);
+				if (iter == maps.end()) return;
+				pending = iter->second;
+				maps.erase(iter);
+			}
+			pending.wait();
+		}
+		//drops the registry's reference. the map is freed right away if nothing's using it, or when the last search lets go
+	}
+}
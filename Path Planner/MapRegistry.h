@@ -0,0 +1,46 @@
+#include <string>
+#include <memory>
+#include <atomic>
+#include <future>
+#include <mutex>
+#include <functional>
+#include <unordered_map>
+
+#include "PathSearch.h"
+#pragma once
+
+namespace ufl_cap4053
+{
+	namespace searches
+	{
+		//keeps the search graph for every map the server has loaded, so switching maps doesn't rebuild anything
+		//maps load on worker threads, and each one is built once no matter how many searches use it
+		class MapRegistry
+		{
+		private:
+			struct LoadedMap {
+				std::shared_ptr<ufl_cap4053::TileMap> tileMap;
+				std::unique_ptr<PathSearch::SearchGraph> graph;
+				std::atomic<long> users{0};	//graphs handed out by acquireGraph that haven't been let go yet
+			};
+			//the graph only points at its tiles, so the two live and die together
+
+			std::unordered_map<std::string, std::shared_future<std::shared_ptr<LoadedMap>>> maps;
+			mutable std::mutex mapsLock;
+			//the lock only covers the table. waiting on a load happens outside it, so one slow map doesn't block the others
+
+			std::shared_ptr<LoadedMap> findLoaded(const std::string& key) const;
+
+		public:
+			DLLEXPORT MapRegistry();
+			DLLEXPORT ~MapRegistry();
+			DLLEXPORT bool loadAsync(const std::string& key, std::function<std::shared_ptr<ufl_cap4053::TileMap>()> loader);
+			DLLEXPORT bool isLoaded(const std::string& key) const;
+			DLLEXPORT bool waitForMap(const std::string& key) const;
+			DLLEXPORT std::shared_ptr<PathSearch::SearchGraph> acquireGraph(const std::string& key) const;
+			DLLEXPORT std::unique_ptr<PathSearch> createSearch(const std::string& key) const;
+			DLLEXPORT long useCount(const std::string& key) const;
+			DLLEXPORT void unloadMap(const std::string& key);
+		};
+	}
+}  // close namespace ufl_cap4053::searches
@@ -28,9 +28,11 @@ namespace ufl_cap4053
 			return neighbors;
 		}
 
-		PathSearch::PlannerNode::PlannerNode(PathSearch::SearchNode* v, PathSearch::PlannerNode* p, float heuristic, float unitLength) {
+		PathSearch::PlannerNode::PlannerNode(PathSearch::SearchNode* v, PathSearch::PlannerNode* p, float heuristic, float unitLength, float weight) {
 			vertex = v;
 			parent = p;
+			this->heuristic = heuristic;
+			open = false;
 			//Tile* currentTile = v->getTile();
 			//heuristic = sqrt(pow(goalRow - currentTile->getYCoordinate(), 2) + pow(goalCol - currentTile->getXCoordinate(), 2));
 			//since we won't need to remember just the heuristic for anything, we instead calculate it outside and pass in the result, since there's no need to store it
@@ -38,12 +40,15 @@ namespace ufl_cap4053
 			givenCost = p->getCost() + (getTile()->getWeight() * unitLength);
 			//we need to remember the given cost, since the paren't influences the child's
 			//given cost is cost to get to parent plus the weight to get here
-			totalCost = heuristic * HEURISTIC_WEIGHT + givenCost;
+			totalCost = heuristic * weight + givenCost;
+			//we do hold on to the heuristic now, since anytime search has to recompute this every time it lowers the weight
 		}
 
 		PathSearch::PlannerNode::PlannerNode(PathSearch::SearchNode* v, float heuristic) {
 			vertex = v;
 			parent = nullptr;
+			this->heuristic = heuristic;
+			open = false;
 			Tile* currentTile = v->getTile();
 			//heuristic = sqrt(pow(goalRow - currentTile->getYCoordinate(), 2) + pow(goalCol - currentTile->getXCoordinate(), 2));
 			//multiplies the straight line distance to the goal by the weight of the current tile
@@ -65,9 +70,9 @@ namespace ufl_cap4053
 			return parent;
 		}
 
-		/* float PathSearch::PlannerNode::getHeuristic() const {
+		float PathSearch::PlannerNode::getHeuristic() const {
 			return heuristic;
-		} */
+		}
 
 		float PathSearch::PlannerNode::getCost() const {
 			return givenCost;
@@ -77,8 +82,80 @@ namespace ufl_cap4053
 			return totalCost;
 		}
 
+		void PathSearch::PlannerNode::reparent(PathSearch::PlannerNode* p, float cost, float weight) {
+			parent = p;
+			givenCost = cost;
+			totalCost = heuristic * weight + givenCost;
+		}
+		//anytime search can find a cheaper route to a node that already has children pointing at it
+		//so we update it in place instead of replacing it, which keeps those children's parent pointers valid
+
+		void PathSearch::PlannerNode::reweigh(float weight) {
+			totalCost = heuristic * weight + givenCost;
+		}
+
+		PathSearch::SolutionView::SolutionView(Tile const* const* f, size_t c) {
+			first = f;
+			count = c;
+		}
+
+		Tile const* const* PathSearch::SolutionView::begin() const { return first; }
+
+		Tile const* const* PathSearch::SolutionView::end() const { return first + count; }
+
+		size_t PathSearch::SolutionView::size() const { return count; }
+
+		bool PathSearch::SolutionView::empty() const { return count == 0; }
+
+		Tile const* PathSearch::SolutionView::operator[](size_t i) const { return first[i]; }
+
+#ifdef PATHSEARCH_STATS
+		void PathSearch::SearchStats::pushed() {
+			pushes++;
+			openListSize++;
+			if (openListSize > maxOpenListSize) maxOpenListSize = openListSize;
+		}
+
+		void PathSearch::SearchStats::popped() {
+			nodesExpanded++;
+			openListSize--;
+		}
+
+		void PathSearch::SearchStats::resetSearch() {
+			double savedLoad = loadMicroseconds;
+			*this = SearchStats();
+			loadMicroseconds = savedLoad;
+		}
+		//load only happens once per map, so a new search keeps its time around
+
+		std::string PathSearch::SearchStats::toJson() const {
+			std::ostringstream json;
+			json << "{\"nodesExpanded\": " << nodesExpanded
+				<< ", \"pushes\": " << pushes
+				<< ", \"decreaseKeys\": " << decreaseKeys
+				<< ", \"discardedRelaxations\": " << discardedRelaxations
+				<< ", \"maxOpenListSize\": " << maxOpenListSize
+				<< ", \"allocatedNodes\": " << allocatedNodes
+				<< ", \"updateCalls\": " << updateCalls
+				<< ", \"phaseMicroseconds\": {\"load\": " << loadMicroseconds
+				<< ", \"initialize\": " << initializeMicroseconds
+				<< ", \"update\": " << updateMicroseconds
+				<< ", \"searchFinalize\": " << finalizeMicroseconds << "}}";
+			return json.str();
+		}
+		//flat enough that there's no need for a json library
+
+		PathSearch::PhaseTimer::PhaseTimer(double& t) : total(t) {
+			start = std::chrono::steady_clock::now();
+		}
+
+		PathSearch::PhaseTimer::~PhaseTimer() {
+			total += std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+		}
+#endif
+
 		//our search space is a hexagonal grid, so addjacency isn't as simple as up down left right
-		bool PathSearch::areAdjacent(const Tile* lhs, const Tile* rhs) {
+		bool PathSearch::SearchGraph::areAdjacent(const Tile* lhs, const Tile* rhs) {
 			if (lhs->getRow() == rhs->getRow() && lhs->getColumn() == rhs->getColumn()) return false; //tile isn't adjacent to itself
 			else if (lhs->getRow() % 2 == 0) {
 				if (rhs->getColumn() <= lhs->getColumn()) return true; //all tiles to the left and inline with an even column tile are adjacent
@@ -96,17 +173,18 @@ namespace ufl_cap4053
 		//since we only call areAdjacent on the nodes directly surrounding a tile, we can make some assumptions
 		//namely, that rhs will be one of the 9 tiles in a 3 x 3 grid (of squares) centered on lhs
 		//thus, we only need to check if the conditions for a tile in this space to not be adjacent are true
-		//since the conditions to be adjacent are immplicity already set in buildSearchGraph
+		//since the conditions to be adjacent are immplicity already set in the SearchGraph constructor
 		//this simplifies areAdjacent considerably
 
-		void PathSearch::buildSearchGraph() {
+		PathSearch::SearchGraph::SearchGraph(TileMap* map) : drawing(false) {
+			tileMap = map;
 			int rows = tileMap->getRowCount();
 			int cols = tileMap->getColumnCount();
 			for (int i = 0; i < rows; i++) {
 				for (int j = 0; j < cols; j++) {
 					Tile* currentTile = tileMap->getTile(i, j);
 					SearchNode* newNode = new SearchNode(currentTile);
-					searchGraph[currentTile] = newNode;
+					nodes[currentTile] = newNode;
 				}
 			}
 			//first we go through and add all tiles to the search graph
@@ -130,7 +208,7 @@ namespace ufl_cap4053
 							Tile* currentNeighbor = tileMap->getTile(neighborRow, neighborCol);
 							if (currentNeighbor->getWeight() == 0) continue;	//if the tile is impassible, it's not a neighbor
 							if (areAdjacent(currentTile, currentNeighbor)) {
-								searchGraph[currentTile]->addNeighbor(searchGraph[currentNeighbor]);
+								nodes[currentTile]->addNeighbor(nodes[currentNeighbor]);
 							}
 						}
 					}
@@ -138,13 +216,224 @@ namespace ufl_cap4053
 			}
 		}
 
+		PathSearch::SearchGraph::~SearchGraph() {
+			for (auto iter = nodes.begin(); iter != nodes.end(); iter++) {
+				delete iter->second;
+			}
+		}
+
+		PathSearch::SearchNode* PathSearch::SearchGraph::getNode(Tile* t) const {
+			return nodes.find(t)->second;
+		}
+		//every tile gets a node, so the find never misses
+
+		TileMap* PathSearch::SearchGraph::getTileMap() const {
+			return tileMap;
+		}
+
+		bool PathSearch::SearchGraph::claimDrawing() {
+			bool expected = false;
+			return drawing.compare_exchange_strong(expected, true);
+		}
+		//false if another search already has it
+
+		void PathSearch::SearchGraph::releaseDrawing() {
+			drawing.store(false);
+		}
+
+		//distance fields give the cost from every tile to one goal, using the same cost as the search:
+		//stepping onto a tile costs its weight times the step size. unreachable and impassible tiles are INFINITY
+		//the output is row major, and reuses whatever capacity distances already has
+		void PathSearch::computeDistanceField(int goalRow, int goalCol, std::vector<float>& distances, PathSearch::DistanceFieldEngine engine) {
+			int rows = tileMap->getRowCount();
+			int cols = tileMap->getColumnCount();
+			distances.assign(rows * cols, INFINITY);
+			if (tileMap->getTile(goalRow, goalCol)->getWeight() == 0) return;	//can't reach an impassible goal from anywhere
+
+			if (engine == WAVEFRONT_ENGINE) wavefrontDistanceField(goalRow, goalCol, distances);
+			else dijkstraDistanceField(goalRow, goalCol, distances);
+		}
+
+		void PathSearch::dijkstraDistanceField(int goalRow, int goalCol, std::vector<float>& distances) {
+			int cols = tileMap->getColumnCount();
+			typedef std::pair<float, Tile*> QueueEntry;
+			std::priority_queue<QueueEntry, vector<QueueEntry>, std::greater<QueueEntry>> frontier;
+			//the framework's queue needs a comparator on planner nodes, so std's is simpler here
+
+			Tile* goalTile = tileMap->getTile(goalRow, goalCol);
+			distances[goalRow * cols + goalCol] = 0;
+			frontier.push(QueueEntry(0.0f, goalTile));
+
+			while (!frontier.empty()) {
+				QueueEntry current = frontier.top();
+				frontier.pop();
+				Tile* currentTile = current.second;
+				if (current.first > distances[currentTile->getRow() * cols + currentTile->getColumn()]) continue;
+				//stale entry: we found a cheaper route after pushing it, which got pushed separately
+
+				float throughCurrent = current.first + currentTile->getWeight() * stepSize;
+				//adjacency goes both ways, so a neighbor gets here by stepping onto the current tile
+				vector<SearchNode*>& neighbors = searchGraph->getNode(currentTile)->getNeighbors();
+				for (int i = 0; i < neighbors.size(); i++) {
+					Tile* neighborTile = neighbors[i]->getTile();
+					float& neighborDistance = distances[neighborTile->getRow() * cols + neighborTile->getColumn()];
+					if (throughCurrent < neighborDistance) {
+						neighborDistance = throughCurrent;
+						frontier.push(QueueEntry(throughCurrent, neighborTile));
+					}
+				}
+			}
+		}
+
+		//Bellman-Ford done a row at a time. each row is relaxed from the row above (on the way down) or below (on the way up)
+		//with straight vector math, then left to right and right to left for the tiles in the same row
+		//this repeats until a full down and up pass changes nothing, which is the same fixed point dijkstra finds
+		void PathSearch::wavefrontDistanceField(int goalRow, int goalCol, std::vector<float>& distances) {
+			int rows = tileMap->getRowCount();
+			int cols = tileMap->getColumnCount();
+			int stride = ((cols + 2 + WAVEFRONT_LANES - 1) / WAVEFRONT_LANES) * WAVEFRONT_LANES;
+			//each row gets a padding tile on both sides so the diagonal neighbors of the first and last columns can be read without bounds checks
+			//padding is INFINITY everywhere, so it never wins a min
+
+			wavefrontDistance.assign(rows * stride, INFINITY);
+			wavefrontEnterCost.assign(rows * stride, INFINITY);
+			wavefrontBlocked.assign(rows * stride, INFINITY);
+			wavefrontThrough.assign(rows * stride, INFINITY);
+			for (int i = 0; i < rows; i++) {
+				for (int j = 0; j < cols; j++) {
+					int weight = tileMap->getTile(i, j)->getWeight();
+					if (weight == 0) continue;
+					wavefrontEnterCost[i * stride + j + 1] = weight * stepSize;
+					wavefrontBlocked[i * stride + j + 1] = 0;
+				}
+			}
+			//blocked is added to every candidate, so impassible tiles (INFINITY) can never take a distance
+			//that's cheaper than a branch per tile, and it keeps the inner loops vectorizable
+
+			wavefrontDistance[goalRow * stride + goalCol + 1] = 0;
+
+			float* distance = wavefrontDistance.data();
+			float* through = wavefrontThrough.data();
+			const float* enter = wavefrontEnterCost.data();
+			const float* blocked = wavefrontBlocked.data();
+
+			auto refreshThrough = [&](int row) {
+				for (int j = 0; j < stride; j++) {
+					through[row * stride + j] = distance[row * stride + j] + enter[row * stride + j];
+				}
+			};
+			//through is the cost for a neighbor to get to the goal by way of a tile: the tile's distance plus the cost to step on it
+
+			for (int i = 0; i < rows; i++) {
+				relaxRowSideways(distance + i * stride, enter + i * stride, blocked + i * stride, cols);
+				refreshThrough(i);
+			}
+
+			bool changed = true;
+			while (changed) {
+				changed = false;
+				for (int i = 1; i < rows; i++) {
+					int parityShift = (i % 2 == 0) ? -1 : 1;
+					bool rowChanged = relaxRowFromNeighbor(distance + i * stride, through + (i - 1) * stride, blocked + i * stride, parityShift, stride);
+					if (rowChanged) {
+						relaxRowSideways(distance + i * stride, enter + i * stride, blocked + i * stride, cols);
+						refreshThrough(i);
+						changed = true;
+					}
+				}
+				//downward pass
+
+				for (int i = rows - 2; i >= 0; i--) {
+					int parityShift = (i % 2 == 0) ? -1 : 1;
+					bool rowChanged = relaxRowFromNeighbor(distance + i * stride, through + (i + 1) * stride, blocked + i * stride, parityShift, stride);
+					if (rowChanged) {
+						relaxRowSideways(distance + i * stride, enter + i * stride, blocked + i * stride, cols);
+						refreshThrough(i);
+						changed = true;
+					}
+				}
+				//upward pass
+			}
+
+			for (int i = 0; i < rows; i++) {
+				for (int j = 0; j < cols; j++) {
+					distances[i * cols + j] = distance[i * stride + j + 1];
+				}
+			}
+			//copy out of the padded grid
+		}
+
+		//same offsets as areAdjacent: an even row touches columns c - 1 and c of the rows above and below it, an odd row touches c and c + 1
+		//parityShift is the -1 or +1. row, blocked and neighborThrough all point at the start of a padded row, so index j is column j - 1
+		bool PathSearch::relaxRowFromNeighbor(float* row, const float* neighborThrough, const float* blocked, int parityShift, int count) {
+			bool changed = false;
+			int j = 1;
+#ifdef __AVX2__
+			for (; j + WAVEFRONT_LANES <= count - 1; j += WAVEFRONT_LANES) {
+				__m256 current = _mm256_loadu_ps(row + j);
+				__m256 straight = _mm256_loadu_ps(neighborThrough + j);
+				__m256 diagonal = _mm256_loadu_ps(neighborThrough + j + parityShift);
+				__m256 candidate = _mm256_add_ps(_mm256_min_ps(straight, diagonal), _mm256_loadu_ps(blocked + j));
+				__m256 improved = _mm256_cmp_ps(candidate, current, _CMP_LT_OQ);
+				if (_mm256_movemask_ps(improved)) {
+					_mm256_storeu_ps(row + j, _mm256_min_ps(candidate, current));
+					changed = true;
+				}
+			}
+			//unaligned loads, since the diagonal is one float off from the rest no matter how the rows line up
+#endif
+			for (; j < count - 1; j++) {
+				float candidate = std::min(neighborThrough[j], neighborThrough[j + parityShift]) + blocked[j];
+				if (candidate < row[j]) {
+					row[j] = candidate;
+					changed = true;
+				}
+			}
+			//leftovers, or the whole row without AVX2. plain enough that the compiler can still vectorize it
+			return changed;
+		}
+
+		//same row neighbors depend on each other, so this part can't be vectorized. one pass each way covers any run of tiles
+		bool PathSearch::relaxRowSideways(float* row, const float* enter, const float* blocked, int count) {
+			bool changed = false;
+			float carried = INFINITY;	//cost to the goal by way of the tile we just passed
+			for (int j = 1; j <= count; j++) {
+				float candidate = carried + blocked[j];
+				if (candidate < row[j]) {
+					row[j] = candidate;
+					changed = true;
+				}
+				carried = row[j] + enter[j];
+			}
+			//left to right
+
+			carried = INFINITY;
+			for (int j = count; j >= 1; j--) {
+				float candidate = carried + blocked[j];
+				if (candidate < row[j]) {
+					row[j] = candidate;
+					changed = true;
+				}
+				carried = row[j] + enter[j];
+			}
+			//right to left
+			return changed;
+		}
+
 		void PathSearch::searchIteration() {
+			if (anytime) {
+				anytimeIteration();
+				return;
+			}
+			//anytime search has its own iteration, since it has to handle closed nodes getting cheaper
+
 			PlannerNode* current = searchQueue.front();
 			SearchNode* currentSearch = current->getNode();
 			Tile* currentTile = current->getTile();
 			visited.insert(currentSearch);
 			searchQueue.pop();
-			currentTile->setFill(0xFF0000FF);
+			SEARCH_STAT(stats.popped());
+			if (visualize) currentTile->setFill(0xFF0000FF);
 			//get node at front of queue, mark it as visited and remove it from the queue
 
 			if (currentTile->getRow() == endRow && currentTile->getColumn() == endCol) {
@@ -158,13 +447,15 @@ namespace ufl_cap4053
 					SearchNode* currentNeighbor = currentNodeNeighbors[i];
 
 					if (visited.find(currentNeighbor) != visited.end()) {
+						SEARCH_STAT(stats.discardedRelaxations++);
 						continue;
 					}
 
 					//if we've already visited the node, move on. continute before we allocate the new planner as an optimization
 
 					float newNodeHeuristic = sqrt(pow(endY - currentNeighbor->getTile()->getYCoordinate(), 2) + pow(endX - currentNeighbor->getTile()->getXCoordinate(), 2));
-					PlannerNode* newNode = new PlannerNode(currentNeighbor, current, newNodeHeuristic, stepSize);
+					PlannerNode* newNode = new PlannerNode(currentNeighbor, current, newNodeHeuristic, stepSize, heuristicWeight);
+					SEARCH_STAT(stats.allocatedNodes++);
 					//as discussed in the planner node constructor, we get the heuristic outside and then let it fall to the wayside since nothing actually depends on 
 					//just the heuristic
 
@@ -179,10 +470,12 @@ namespace ufl_cap4053
 							delete queuedNodes[currentNeighbor];
 							queuedNodes[currentNeighbor] = newNode;
 							searchQueue.push(newNode);
+							SEARCH_STAT(stats.decreaseKeys++);
 							//if a new path to a node is more efficient, deallocate the old node and replace it with the better one
 						}
 						else {
 							delete newNode;
+							SEARCH_STAT(stats.discardedRelaxations++);
 						}
 					}
 					//if the node is in the queue, check if the new route is cheaper
@@ -190,9 +483,10 @@ namespace ufl_cap4053
 					//if not, just move on
 
 					else {
-						currentNeighbor->getTile()->setFill(0xFF00FF00);
+						if (visualize) currentNeighbor->getTile()->setFill(0xFF00FF00);
 						queuedNodes[currentNeighbor] = newNode;
 						searchQueue.push(newNode);
+						SEARCH_STAT(stats.pushed());
 					}
 
 					//if it's a brand new node, put it in the queue
@@ -207,17 +501,146 @@ namespace ufl_cap4053
 			}
 		}
 
+		//ARA*: search with a big heuristic weight to get a path fast, then keep lowering the weight and improving it
+		//each pass reuses every planner node from the last one instead of starting over, so later passes are cheap
+		void PathSearch::anytimeIteration() {
+			auto goalIter = queuedNodes.find(goalNode);
+			PlannerNode* goal = (goalIter != queuedNodes.end()) ? goalIter->second : nullptr;
+
+			if (searchQueue.empty() || (goal && goal->getCost() <= searchQueue.front()->getTotalCost())) {
+				if (goal) publishSolution(goal);
+				else done = true;	//nothing left to search and we never reached the goal, so there's no path
+				return;
+			}
+			//the goal's heuristic is 0, so its given cost is its total cost. once nothing in the queue can beat it, this pass is finished
+			//unlike regular A* we don't wait to pop the goal, since it may have been expanded in an earlier pass and not be in the queue at all
+
+			PlannerNode* current = searchQueue.front();
+			SearchNode* currentSearch = current->getNode();
+			searchQueue.pop();
+			SEARCH_STAT(stats.popped());
+			current->open = false;
+			visited.insert(currentSearch);
+			if (visualize) current->getTile()->setFill(0xFF0000FF);
+
+			vector<SearchNode*>& currentNodeNeighbors = currentSearch->getNeighbors();
+			for (int i = 0; i < currentNodeNeighbors.size(); i++) {
+				SearchNode* currentNeighbor = currentNodeNeighbors[i];
+				Tile* neighborTile = currentNeighbor->getTile();
+				float newCost = current->getCost() + neighborTile->getWeight() * stepSize;
+
+				auto queuedIter = queuedNodes.find(currentNeighbor);
+				if (queuedIter == queuedNodes.end()) {
+					float newNodeHeuristic = sqrt(pow(endY - neighborTile->getYCoordinate(), 2) + pow(endX - neighborTile->getXCoordinate(), 2));
+					PlannerNode* newNode = new PlannerNode(currentNeighbor, current, newNodeHeuristic, stepSize, heuristicWeight);
+					SEARCH_STAT(stats.allocatedNodes++);
+					if (visualize) neighborTile->setFill(0xFF00FF00);
+					queuedNodes[currentNeighbor] = newNode;
+					newNode->open = true;
+					searchQueue.push(newNode);
+					SEARCH_STAT(stats.pushed());
+					continue;
+				}
+				//brand new node, same as regular A*
+
+				PlannerNode* existing = queuedIter->second;
+				if (newCost >= existing->getCost()) {
+					SEARCH_STAT(stats.discardedRelaxations++);
+					continue;
+				}
+				//not an improvement, move on
+
+				if (existing->open) {
+					searchQueue.remove(existing);
+					existing->reparent(current, newCost, heuristicWeight);
+					searchQueue.push(existing);
+					SEARCH_STAT(stats.decreaseKeys++);
+				}
+				//still queued, so just re-sort it with its new cost
+				else if (visited.find(currentNeighbor) != visited.end()) {
+					existing->reparent(current, newCost, heuristicWeight);
+					inconsistentNodes.insert(existing);
+				}
+				//already expanded this pass. expanding it again would break the weighted bound, so it waits for the next pass
+				else {
+					existing->reparent(current, newCost, heuristicWeight);
+					existing->open = true;
+					searchQueue.push(existing);
+					SEARCH_STAT(stats.pushed());
+				}
+				//expanded in an earlier pass, so it's fair game to go back in the queue
+			}
+		}
+
+		void PathSearch::publishSolution(PathSearch::PlannerNode* goal) {
+			finalPath.clear();
+			searchFinalize(goal);
+			solutionImproved = true;
+
+			float lowestUnweightedCost = INFINITY;
+			for (auto iter = queuedNodes.begin(); iter != queuedNodes.end(); iter++) {
+				PlannerNode* node = iter->second;
+				if (node->open || inconsistentNodes.find(node) != inconsistentNodes.end()) {
+					float unweightedCost = node->getCost() + node->getHeuristic();
+					if (unweightedCost < lowestUnweightedCost) lowestUnweightedCost = unweightedCost;
+				}
+			}
+			//anything that could still improve the path is in the queue or waiting to be requeued
+			//the cheapest of those (without the weight) is a lower bound on the optimal cost
+
+			suboptimalityBound = std::min(heuristicWeight, goal->getCost() / lowestUnweightedCost);
+			if (suboptimalityBound < ANYTIME_FINAL_WEIGHT) suboptimalityBound = ANYTIME_FINAL_WEIGHT;
+			//if nothing's left the division gives 0, and the path is optimal
+
+			if (heuristicWeight <= ANYTIME_FINAL_WEIGHT || suboptimalityBound <= ANYTIME_FINAL_WEIGHT || anytimeWeightStep <= 0) {
+				done = true;
+				return;
+			}
+			//can't do any better than optimal, so stop here
+
+			heuristicWeight = std::max(heuristicWeight - anytimeWeightStep, (float)ANYTIME_FINAL_WEIGHT);
+
+			for (auto iter = inconsistentNodes.begin(); iter != inconsistentNodes.end(); iter++) {
+				(*iter)->open = true;
+			}
+			inconsistentNodes.clear();
+			searchQueue.clear();
+			SEARCH_STAT(stats.openListSize = 0);
+			for (auto iter = queuedNodes.begin(); iter != queuedNodes.end(); iter++) {
+				PlannerNode* node = iter->second;
+				if (node->open) {
+					node->reweigh(heuristicWeight);
+					searchQueue.push(node);
+					SEARCH_STAT(stats.pushed());
+				}
+			}
+			visited.clear();
+			//start the next pass: move the inconsistent nodes back into the queue, re-sort everything with the new weight
+			//and forget what was expanded, since every node gets one expansion per pass
+		}
+
 		void PathSearch::searchFinalize(PathSearch::PlannerNode* endpoint) {
+			SEARCH_STAT(PhaseTimer timer(stats.finalizeMicroseconds));
+			size_t pathLength = 0;
+			for (PlannerNode* current = endpoint; current; current = current->getParent()) pathLength++;
+			finalPath.resize(pathLength);
+			//count the path first so we can write it straight into place in either order, instead of building it backwards and reversing
+			//resize keeps the capacity from earlier searches, so after the first long path this doesn't allocate
+
+			size_t index = startToGoal ? pathLength - 1 : 0;
 			PlannerNode* current = endpoint;
 			while (current) {
-				finalPath.push_back(current->getTile());
+				finalPath[index] = current->getTile();
+				if (startToGoal) index--;
+				else index++;
 				if (current->getParent() != nullptr) {
-					current->getTile()->addLineTo(current->getParent()->getTile(), 0xFFFF0000);
+					if (visualize) current->getTile()->addLineTo(current->getParent()->getTile(), 0xFFFF0000);
 					current = current->getParent();
 				}
 				else break;
 			}
 			//builds the final path vector and draws the line from start to end
+			solutionFound = true;
 			return;
 		}
 
@@ -236,6 +659,17 @@ namespace ufl_cap4053
 			endRow = 0;
 			endCol = 0;
 			done = false;
+			heuristicWeight = HEURISTIC_WEIGHT;
+			fixedWeight = HEURISTIC_WEIGHT;
+			anytime = false;
+			anytimeInitialWeight = HEURISTIC_WEIGHT;
+			anytimeWeightStep = 0;
+			suboptimalityBound = HEURISTIC_WEIGHT;
+			solutionFound = false;
+			solutionImproved = false;
+			startToGoal = false;
+			visualize = false;
+			goalNode = nullptr;
 		}
 
 		PathSearch::~PathSearch() {
@@ -248,14 +682,34 @@ namespace ufl_cap4053
 		//but it can't hurt, and it will clean up everything. So no reason not to
 
 		void PathSearch::load(ufl_cap4053::TileMap* _tilemap) {
-			tileMap = _tilemap;
+			SEARCH_STAT(stats.loadMicroseconds = 0);
+			SEARCH_STAT(PhaseTimer timer(stats.loadMicroseconds));
+			bindGraph(std::make_shared<SearchGraph>(_tilemap));
+			visualize = searchGraph->claimDrawing();
+			return;
+		}
+		//builds a graph only this search uses, so it can always draw on the tiles the way the framework expects
+
+		void PathSearch::load(std::shared_ptr<PathSearch::SearchGraph> sharedGraph) {
+			SEARCH_STAT(stats.loadMicroseconds = 0);
+			SEARCH_STAT(PhaseTimer timer(stats.loadMicroseconds));
+			bindGraph(sharedGraph);
+			return;
+		}
+		//uses a graph that's already built, like the ones the map registry hands out
+		//other searches may be on the same tiles, so this one doesn't draw unless setVisualization turns it on
+
+		void PathSearch::bindGraph(std::shared_ptr<PathSearch::SearchGraph> graph) {
+			setVisualization(false);	//the claim was on the old graph
+			searchGraph = graph;
+			tileMap = graph->getTileMap();
 			stepSize = tileMap->getTileRadius() * 2;
 			//distance to go from one tile to an adjacent is always 2 * radius, since we go center to center
-			buildSearchGraph();
-			return;
 		}
 
 		void PathSearch::initialize(int startRow, int startCol, int goalRow, int goalCol) {
+			SEARCH_STAT(stats.resetSearch());
+			SEARCH_STAT(PhaseTimer timer(stats.initializeMicroseconds));
 			//shutdown();	//issues with running a timed go multiple times in a row, this helps clean it up
 			//actual issue comes from having text highlighted in the console output, I believe. Not actually from things not deallocating
 			//since shutdown is called right after the search when we do a timed run. When it comes to the crash from the conole, I'm
@@ -274,23 +728,37 @@ namespace ufl_cap4053
 			//coordinate endpoints of the goal for heuristics
 
 			done = false;
+			solutionFound = false;
+			goalNode = searchGraph->getNode(tileMap->getTile(endRow, endCol));
+			heuristicWeight = anytime ? anytimeInitialWeight : fixedWeight;
+			suboptimalityBound = heuristicWeight;
+			//every search starts over from the initial weight
+
 			float firstHeuristic = sqrt(pow(endY - tileMap->getTile(startRow, startCol)->getYCoordinate(), 2) + pow(endX - tileMap->getTile(startRow, startCol)->getXCoordinate(), 2));
-			PlannerNode* firstNode = new PlannerNode(searchGraph[tileMap->getTile(startRow, startCol)], firstHeuristic);
+			SearchNode* firstSearchNode = searchGraph->getNode(tileMap->getTile(startRow, startCol));
+			PlannerNode* firstNode = new PlannerNode(firstSearchNode, firstHeuristic);
+			firstNode->open = true;
 			searchQueue.push(firstNode);
-			queuedNodes[searchGraph[tileMap->getTile(startRow, startCol)]] = firstNode;
+			SEARCH_STAT(stats.allocatedNodes++);
+			SEARCH_STAT(stats.pushed());
+			queuedNodes[firstSearchNode] = firstNode;
 			return;
 		}
 
 		void PathSearch::update(long timeslice) {
+			SEARCH_STAT(stats.updateCalls++);
+			SEARCH_STAT(PhaseTimer timer(stats.updateMicroseconds));
 			auto t1 = std::chrono::system_clock::now();
 			auto t2 = std::chrono::system_clock::now();
 			//declare t2 pre-loop so we only have to initiallize it once
+			solutionImproved = false;
 			do {
 				searchIteration();
 				t2 = std::chrono::system_clock::now();
-			} while (std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() < timeslice && !done);
+			} while (std::chrono::duration_cast<std::chrono::milliseconds>(t2 - t1).count() < timeslice && !done && !solutionImproved);
 			//do while so we always perform at least 1 iteration
 			//exit when our timeslice is up, or when we finish
+			//anytime search also exits as soon as it has a better path, so the caller can use it right away
 			return;
 		}
 
@@ -302,17 +770,16 @@ namespace ufl_cap4053
 			//all the nodes that get replaced get deallocated as they get replaced, so no need to worry about that
 			queuedNodes.clear();
 			visited.clear();
+			inconsistentNodes.clear();
 			searchQueue.clear();
 			//empty all our containers
 			//nothing else gets deallocated, since we're still using the search nodes
 		}
 		void PathSearch::unload() {
-			for (auto iter = searchGraph.begin(); iter != searchGraph.end(); iter++) {
-				delete iter->second;
-			}
-			searchGraph.clear();
+			setVisualization(false);
+			searchGraph.reset();
 			return;
-			//deallocate the search graph once we unload the map
+			//let go of the search graph once we unload the map. it gets deallocated when nothing else is sharing it
 			//everything else handled by shutdown, so this is the only container we care about in here
 		}
 
@@ -321,5 +788,56 @@ namespace ufl_cap4053
 		std::vector<Tile const*> const PathSearch::getSolution() const {
 			return finalPath;
 		};
+		//still returns a copy to match the framework, getSolutionView is the way to poll it every frame
+
+		PathSearch::SolutionView PathSearch::getSolutionView() const {
+			return SolutionView(finalPath.data(), finalPath.size());
+		}
+
+		void PathSearch::setSolutionStartToGoal(bool startFirst) {
+			startToGoal = startFirst;
+		}
+
+		bool PathSearch::setVisualization(bool enabled) {
+			if (enabled == visualize) return true;
+			if (!enabled) {
+				searchGraph->releaseDrawing();
+				visualize = false;
+				return true;
+			}
+			visualize = searchGraph && searchGraph->claimDrawing();
+			return visualize;
+		}
+		//turning it on fails (returns false) without a graph, or while another search on the same graph is drawing.
+		//only the drawing search writes to the tiles, the rest just read their weights and positions, so searches on
+		//a shared graph can run on as many threads as they like
+
+		void PathSearch::setHeuristicWeight(float weight) {
+			fixedWeight = weight;
+		}
+		//takes effect on the next initialize, same as the anytime settings
+
+		void PathSearch::enableAnytime(float initialWeight, float weightStep) {
+			anytime = true;
+			anytimeInitialWeight = std::max(initialWeight, (float)ANYTIME_FINAL_WEIGHT);
+			anytimeWeightStep = weightStep;
+		}
+		//a weight step of 0 or less never lowers the weight, so the search stops after the first path
+
+		void PathSearch::disableAnytime() {
+			anytime = false;
+		}
+
+		bool PathSearch::hasSolution() const { return solutionFound; }
+
+		float PathSearch::getSuboptimalityBound() const { return suboptimalityBound; }
+
+#ifdef PATHSEARCH_STATS
+		PathSearch::SearchStats const& PathSearch::getStats() const { return stats; }
+
+		std::string PathSearch::getStatsJson() const { return stats.toJson(); }
+
+		void PathSearch::resetStats() { stats = SearchStats(); }
+#endif
 	}
 }
\ No newline at end of file
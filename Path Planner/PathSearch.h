@@ -1,9 +1,19 @@
 #include <vector>
+#include <algorithm>
+#include <cmath>
 #include <queue>
+#include <functional>
 #include <unordered_map>
 #include <unordered_set>
 #include <chrono>
+#include <memory>
+#include <atomic>
 #include <iostream>
+#include <string>
+#include <sstream>
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
 //#include <stdlib.h>
 //#include <crtdbg.h>
 
@@ -14,6 +24,16 @@
 
 //#define _CRTDBG_MAP_ALLOC
 #define HEURISTIC_WEIGHT 1.2	//heuristic weight to match the example program
+#define ANYTIME_FINAL_WEIGHT 1.0	//anytime search stops improving once the weight gets here, since that's plain (optimal) A*
+
+//#define PATHSEARCH_STATS	//uncomment to collect search counters and phase timings. when it's off, none of it gets compiled
+#define WAVEFRONT_LANES 8	//floats per AVX2 register. rows in the wavefront grids are padded to a multiple of this
+
+#ifdef PATHSEARCH_STATS
+#define SEARCH_STAT(statement) statement
+#else
+#define SEARCH_STAT(statement)
+#endif
 
 
 namespace ufl_cap4053
@@ -22,6 +42,61 @@ namespace ufl_cap4053
 	{
 		class PathSearch
 		{
+		public:
+			enum DistanceFieldEngine {
+				DIJKSTRA_ENGINE,		//priority queue over the search graph
+				WAVEFRONT_ENGINE		//repeated vectorized row sweeps until nothing changes
+			};
+
+			class SolutionView {
+				ufl_cap4053::Tile const* const* first;
+				size_t count;
+			public:
+				SolutionView(ufl_cap4053::Tile const* const* f, size_t c);
+				ufl_cap4053::Tile const* const* begin() const;
+				ufl_cap4053::Tile const* const* end() const;
+				size_t size() const;
+				bool empty() const;
+				ufl_cap4053::Tile const* operator[](size_t i) const;
+			};
+			//read-only window into the path buffer, so polling the path doesn't copy it
+			//only good until the next initialize or update, since those can rewrite the buffer
+
+#ifdef PATHSEARCH_STATS
+			struct SearchStats {
+				unsigned long long nodesExpanded = 0;
+				unsigned long long pushes = 0;
+				unsigned long long decreaseKeys = 0;			//queued node got a cheaper route and was re-sorted
+				unsigned long long discardedRelaxations = 0;	//neighbor checked, but the route through it was no better
+				unsigned long long maxOpenListSize = 0;
+				unsigned long long allocatedNodes = 0;			//planner nodes created with new
+				unsigned long long openListSize = 0;			//current size, only kept so we can find the max
+
+				unsigned long long updateCalls = 0;
+				double loadMicroseconds = 0;
+				double initializeMicroseconds = 0;
+				double updateMicroseconds = 0;
+				double finalizeMicroseconds = 0;
+				//timings add up across calls until the next initialize (or load, for the load time)
+
+				void pushed();
+				void popped();
+				void resetSearch();
+				std::string toJson() const;
+			};
+
+		private:
+			class PhaseTimer {
+				double& total;
+				std::chrono::steady_clock::time_point start;
+			public:
+				PhaseTimer(double& t);
+				~PhaseTimer();
+			};
+			//adds the time between construction and destruction to a stats field, so a phase is timed by declaring one at the top
+
+			SearchStats stats;
+#endif
 		private:
 			class SearchNode {
 				ufl_cap4053::Tile* vertex;
@@ -37,28 +112,52 @@ namespace ufl_cap4053
 				friend class PathSearch;
 				SearchNode* vertex;
 				PlannerNode* parent;
-				//float heuristic;
+				float heuristic;	//kept so the total cost can be recomputed when the anytime search lowers its weight
 				float givenCost;
 				float totalCost;
+				bool open;	//whether the node is currently in the search queue
 			public:
-				PlannerNode(SearchNode* v, PlannerNode* p, float heuristic, float unitLength);
+				PlannerNode(SearchNode* v, PlannerNode* p, float heuristic, float unitLength, float weight);
 				PlannerNode(SearchNode* v, float heuristic);
 				PlannerNode* getParent() const;
 				SearchNode* getNode() const;
 				ufl_cap4053::Tile* getTile() const;
-				//float getHeuristic() const;
+				float getHeuristic() const;
 				float getCost() const;
 				float getTotalCost() const;
+				void reparent(PlannerNode* p, float cost, float weight);
+				void reweigh(float weight);
+			};
+
+		public:
+			class SearchGraph {
+				std::unordered_map<ufl_cap4053::Tile*, SearchNode*> nodes;
+				ufl_cap4053::TileMap* tileMap;
+				std::atomic<bool> drawing;	//set while one of the searches using this graph colors its tiles
+				static bool areAdjacent(const Tile* lhs, const Tile* rhs);
+			public:
+				SearchGraph(ufl_cap4053::TileMap* map);
+				~SearchGraph();
+				SearchGraph(const SearchGraph&) = delete;
+				SearchGraph& operator=(const SearchGraph&) = delete;
+				SearchNode* getNode(ufl_cap4053::Tile* t) const;
+				ufl_cap4053::TileMap* getTileMap() const;
+				bool claimDrawing();
+				void releaseDrawing();
 			};
+			//the adjacency for one map. nothing changes it after it's built, so any number of searches can share one
+			//drawing does write to the tiles though, so only the search holding the claim does that, see setVisualization
 
+		private:
 			static bool isGreaterThan(PlannerNode* const& lhs, PlannerNode* const& rhs);
 
-			std::unordered_map<ufl_cap4053::Tile*, SearchNode*> searchGraph;
+			std::shared_ptr<SearchGraph> searchGraph;
 			std::unordered_map<SearchNode*, PlannerNode*> queuedNodes;
 			std::unordered_set<SearchNode*> visited;
 			//std::queue<PlannerNode*> searchQueue;
 			ufl_cap4053::PriorityQueue<PlannerNode*> searchQueue;
 			std::vector<Tile const*> finalPath;
+			std::unordered_set<PlannerNode*> inconsistentNodes;	//closed nodes that got cheaper this pass, requeued when the weight drops (ARA*)
 
 			ufl_cap4053::TileMap* tileMap;
 
@@ -75,10 +174,33 @@ namespace ufl_cap4053
 
 			bool done;
 
-			void buildSearchGraph();
+			float heuristicWeight;		//weight in use by the current search
+			float fixedWeight;			//weight used when not running anytime
+			bool anytime;
+			float anytimeInitialWeight;
+			float anytimeWeightStep;
+			float suboptimalityBound;	//solution cost is at most this times the optimal cost
+			bool solutionFound;
+			bool solutionImproved;		//lets update() hand back control as soon as a better path is ready
+			bool startToGoal;			//order to write the path in. defaults to goal first, which is what the framework expects
+			bool visualize;				//whether this search colors tiles and draws its path. it holds the graph's drawing claim while it's on
+			SearchNode* goalNode;
+
+			std::vector<float> wavefrontDistance;
+			std::vector<float> wavefrontEnterCost;
+			std::vector<float> wavefrontBlocked;
+			std::vector<float> wavefrontThrough;
+			//padded grids for the wavefront engine, kept around so repeated distance fields don't reallocate
+
+			void bindGraph(std::shared_ptr<SearchGraph> graph);
+			void dijkstraDistanceField(int goalRow, int goalCol, std::vector<float>& distances);
+			void wavefrontDistanceField(int goalRow, int goalCol, std::vector<float>& distances);
+			bool relaxRowFromNeighbor(float* row, const float* neighborThrough, const float* blocked, int parityShift, int count);
+			bool relaxRowSideways(float* row, const float* enter, const float* blocked, int count);
 			void searchIteration();
+			void anytimeIteration();
+			void publishSolution(PlannerNode* goal);
 			void searchFinalize(PlannerNode* endpoint);
-			bool areAdjacent(const Tile* lhs, const Tile* rhs);
 			//private helper functions
 
 		// CLASS DECLARATION GOES HERE
@@ -86,12 +208,27 @@ namespace ufl_cap4053
 				DLLEXPORT PathSearch(); // EX: DLLEXPORT required for public methods - see platform.h
 				DLLEXPORT ~PathSearch();
 				DLLEXPORT void load(ufl_cap4053::TileMap* _tilemap);
+				DLLEXPORT void load(std::shared_ptr<SearchGraph> sharedGraph);
 				DLLEXPORT void initialize(int startRow, int startCol, int goalRow, int goalCol);
 				DLLEXPORT void update(long timeslice);
 				DLLEXPORT void shutdown();
 				DLLEXPORT void unload();
 				DLLEXPORT bool isDone() const;
 				DLLEXPORT std::vector<ufl_cap4053::Tile const*> const getSolution() const;
+				DLLEXPORT SolutionView getSolutionView() const;
+				DLLEXPORT void setSolutionStartToGoal(bool startFirst);
+				DLLEXPORT bool setVisualization(bool enabled);
+				DLLEXPORT void computeDistanceField(int goalRow, int goalCol, std::vector<float>& distances, DistanceFieldEngine engine);
+				DLLEXPORT void setHeuristicWeight(float weight);
+				DLLEXPORT void enableAnytime(float initialWeight, float weightStep);
+				DLLEXPORT void disableAnytime();
+				DLLEXPORT bool hasSolution() const;
+				DLLEXPORT float getSuboptimalityBound() const;
+#ifdef PATHSEARCH_STATS
+				DLLEXPORT SearchStats const& getStats() const;
+				DLLEXPORT std::string getStatsJson() const;
+				DLLEXPORT void resetStats();
+#endif
 		};
 	}
 }  // close namespace ufl_cap4053::searches